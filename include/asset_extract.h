@@ -0,0 +1,58 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASSET_EXTRACT_H
+#define ASSET_EXTRACT_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <blt/std/types.h>
+
+/*
+ * Streaming readers for the json files of a resource pack. Each one makes a single forward pass over the file and only
+ * keeps the fields the asset loader uses, no document is ever built. They all return nothing if the file is not json.
+ */
+
+struct model_fields_t
+{
+	std::optional<std::string> parent;
+	// values of the top level "textures" object in file order, texture variables such as "#all" included
+	std::vector<std::string> textures;
+};
+
+struct biome_fields_t
+{
+	// the first of each key found anywhere in the file
+	std::optional<blt::i64> grass_color;
+	std::optional<std::string> grass_color_modifier;
+	std::optional<blt::i64> foliage_color;
+};
+
+[[nodiscard]] std::optional<model_fields_t> extract_model(std::string_view contents);
+
+// also nothing if the file has no top level "values" list
+[[nodiscard]] std::optional<std::vector<std::string>> extract_tag_values(std::string_view contents);
+
+// every string stored under a "model" key, at any depth
+[[nodiscard]] std::optional<std::vector<std::string>> extract_blockstate_models(std::string_view contents);
+
+[[nodiscard]] std::optional<biome_fields_t> extract_biome(std::string_view contents);
+
+#endif //ASSET_EXTRACT_H
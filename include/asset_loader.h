@@ -20,6 +20,9 @@
 #define ASSET_LOADER_H
 
 #include <sql.h>
+#include <asset_source.h>
+#include <pixel_format.h>
+#include <symbol_table.h>
 #include <blt/outcome/expected.h>
 
 #include <utility>
@@ -38,7 +41,8 @@ public:
 		TAGS_BLOCKSTATES_NOT_FOUND,
 		INVALID_BLOCKSTATE_FORMAT,
 		INCORRECT_NAMESPACE,
-		INCORRECT_TAG_FILE
+		INCORRECT_TAG_FILE,
+		UNSUPPORTED_PIXEL_FORMAT
 	};
 
 	load_failure_t(const type_t type): type{type} // NOLINT
@@ -68,6 +72,8 @@ public:
 				return "Namespace names of models, textures, or data files do not match! " + message.value_or("");
 			case INVALID_BLOCKSTATE_FORMAT:
 				return "Blockstate json file is not structured correctly. " + message.value_or("");
+			case UNSUPPORTED_PIXEL_FORMAT:
+				return "Textures can't be stored in this pixel format. " + message.value_or("");
 			default:
 				return "Unknown failure type. " + message.value_or("");
 		}
@@ -98,12 +104,12 @@ struct model_data_t
 
 struct tag_data_t
 {
-	blt::hashset_t<std::string> list;
+	string_set_t list;
 };
 
 struct block_state_t
 {
-	blt::hashmap_t<std::string, blt::hashset_t<std::string>> models;
+	string_map_t<string_set_t> models;
 };
 
 struct biome_color_t
@@ -114,9 +120,9 @@ struct biome_color_t
 
 struct namespace_data_t
 {
-	blt::hashmap_t<std::string, model_data_t> models;
-	blt::hashmap_t<std::string, tag_data_t> tags;
-	blt::hashmap_t<std::string, block_state_t> block_states;
+	string_map_t<model_data_t> models;
+	string_map_t<tag_data_t> tags;
+	string_map_t<block_state_t> block_states;
 	std::string asset_namespace_folder;
 	std::string data_namespace_folder;
 
@@ -124,34 +130,68 @@ struct namespace_data_t
 	std::string tag_folder;
 	std::string texture_folder;
 
-	blt::hashmap_t<std::string, std::string> textures;
-	blt::hashmap_t<std::string, biome_color_t> biome_colors;
+	string_map_t<source_location_t> textures;
+	string_map_t<biome_color_t> biome_colors;
+
+	// keys whose source file was added, changed or removed since the last build, load_textures only re-derives these
+	string_set_t changed_models;
+	string_set_t changed_textures;
+	string_set_t changed_tags;
+	string_set_t changed_block_states;
+	string_set_t changed_biomes;
 };
 
-struct asset_data_t
+// what the .assets manifest remembers about one source file
+struct manifest_entry_t
 {
-	blt::hashmap_t<std::string, namespace_data_t> json_data;
-	blt::hashmap_t<std::string, blt::hashset_t<std::string>> solid_textures_to_load;
-	blt::hashmap_t<std::string, blt::hashset_t<std::string>> non_solid_textures_to_load;
+	std::string namespace_str;
+	std::string kind;
+	std::string key;
+	blt::i64 size = 0;
+	blt::i64 mtime = 0;
+	blt::i64 hash = 0;
+	// the parts of the file the loader uses as json, unchanged files are rebuilt from this without being read
+	std::string extracted;
+};
 
-	[[nodiscard]] std::vector<namespaced_object> resolve_parents(const namespaced_object& model) const;
+struct asset_data_t
+{
+	string_map_t<namespace_data_t> json_data;
+	string_map_t<string_set_t> solid_textures_to_load;
+	string_map_t<string_set_t> non_solid_textures_to_load;
+
+	// source path -> entry, read from the database on the first load_assets and written back by load_textures
+	string_map_t<manifest_entry_t> manifest;
+	string_set_t manifest_dirty;
+	string_set_t manifest_removed;
+	bool manifest_loaded = false;
+
+	/**
+	 * For each of the models, whether any model up its parent chain (not counting itself) is one of the solid parents.
+	 * Chains are followed across namespaces and every model reached is resolved once, so shared ancestors cost nothing
+	 * after the first model that reaches them. Parent cycles are reported and treated as all of their members.
+	 */
+	[[nodiscard]] blt::hashmap_t<const model_data_t*, bool> resolve_solid_parents(const string_map_t<model_data_t>& models,
+																			  const blt::hashset_t<asset_id_t>& solid_parents) const;
 };
 
 class asset_loader_t
 {
 public:
-	explicit asset_loader_t(std::string name);
+	// textures are stored in the given format, switching formats re-encodes every texture on the next build. UNORM8 is only
+	// what textures become for display and can't be told apart from SRGB8 once stored, load_assets() refuses it
+	explicit asset_loader_t(std::string name, pixel_format_t format = pixel_format_t::RGBA32F);
 
+	// either folder may also be a resource pack .zip or a client .jar, which is read without extracting it
 	std::optional<load_failure_t> load_assets(const std::string& asset_folder, const std::optional<std::string>& data_folder = {});
 
 	database_t& load_textures();
 
 private:
-	void process_texture(const statement_t& stmt, const std::string& namespace_str, const std::string& texture);
-
 	asset_data_t data;
 	database_t db;
 	std::string name;
+	pixel_format_t format;
 };
 
 std::string block_pretty_name(std::string block_name);
@@ -0,0 +1,132 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASSET_SOURCE_H
+#define ASSET_SOURCE_H
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <blt/std/types.h>
+
+// a regular file of a source, paths are relative to the source root and always use '/'
+struct source_file_t
+{
+	std::string path;
+	blt::i64 size = 0;
+	// only ever compared for equality, archives fold the entry's crc in so a same size rewrite within the dos time
+	// resolution is still noticed
+	blt::i64 mtime = 0;
+};
+
+/**
+ * Somewhere load_assets reads a resource pack from, either an extracted folder or a zip / jar read in place without
+ * extracting it. Files are listed once up front and sorted by path, reads can be made from any number of threads.
+ */
+class asset_source_t
+{
+public:
+	virtual ~asset_source_t() = default;
+
+	// opens a folder or a .zip / .jar, nullptr if the location does not exist or is not an archive that can be read
+	static std::shared_ptr<asset_source_t> open(const std::filesystem::path& location);
+
+	[[nodiscard]] const std::vector<std::string>& get_directories() const
+	{
+		return directories;
+	}
+
+	[[nodiscard]] bool has_directory(const std::filesystem::path& directory) const;
+
+	// every file anywhere below the directory
+	[[nodiscard]] std::span<const source_file_t> files_in(const std::filesystem::path& directory) const;
+
+	[[nodiscard]] virtual std::optional<std::string> read(const std::string& path) const = 0;
+
+	// reads the files on every core, independent archive entries are inflated in parallel
+	[[nodiscard]] std::vector<std::optional<std::string>> read_all(const std::vector<const source_file_t*>& wanted) const;
+
+	// where a file lives outside the source, used in logs and as its manifest key
+	[[nodiscard]] virtual std::string describe(const std::string& path) const = 0;
+
+protected:
+	// sorts the listing, directories are filled in from the file paths so archives without directory entries work
+	void finish_listing();
+
+	std::vector<source_file_t> files;
+	std::vector<std::string> directories;
+};
+
+class directory_source_t final : public asset_source_t
+{
+public:
+	explicit directory_source_t(std::filesystem::path root);
+
+	[[nodiscard]] std::optional<std::string> read(const std::string& path) const override;
+
+	[[nodiscard]] std::string describe(const std::string& path) const override;
+
+private:
+	std::filesystem::path root;
+};
+
+class zip_source_t final : public asset_source_t
+{
+public:
+	struct entry_t
+	{
+		blt::u64 local_header_offset;
+		blt::u64 compressed_size;
+		blt::u64 size;
+		blt::u16 method;
+	};
+
+	explicit zip_source_t(std::filesystem::path archive);
+
+	[[nodiscard]] bool is_valid() const
+	{
+		return valid;
+	}
+
+	[[nodiscard]] std::optional<std::string> read(const std::string& path) const override;
+
+	[[nodiscard]] std::string describe(const std::string& path) const override;
+
+private:
+	std::filesystem::path archive;
+	// same order as files
+	std::vector<entry_t> entries;
+	bool valid = false;
+};
+
+// a file of a particular source, textures keep one of these so they can be read once the loader knows it needs them
+struct source_location_t
+{
+	std::shared_ptr<const asset_source_t> source;
+	std::string path;
+
+	[[nodiscard]] std::string string() const
+	{
+		return source ? source->describe(path) : path;
+	}
+};
+
+#endif //ASSET_SOURCE_H
@@ -0,0 +1,123 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLOR_LUT_H
+#define COLOR_LUT_H
+
+#include <array>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <texture_features.h>
+
+// everything the contents of a lut depend on
+struct color_lut_key_t
+{
+	feature_space_t      space             = feature_space_t::OKLAB;
+	blt::i32             samples           = 1;
+	int                  comparator_mode   = 0;
+	std::array<float, 3> factors{};
+	bool                 include_non_solid = false;
+	size_t               resource_generation = 0;
+
+	bool operator==(const color_lut_key_t&) const = default;
+};
+
+/**
+ * Lattice over the linear RGB cube the color pickers work in. Every lattice point stores the closest textures to that
+ * color, nearest first. A query gathers the textures of the 8 points around its color, those only need to be compared
+ * against the query itself to produce a ranking.
+ */
+class color_lut_t
+{
+public:
+	static constexpr blt::i32 resolution      = 32;
+	static constexpr size_t   point_textures  = 32;
+	static constexpr blt::u32 no_texture      = std::numeric_limits<blt::u32>::max();
+	static constexpr size_t   total_values    = static_cast<size_t>(resolution) * resolution * resolution * point_textures;
+
+	color_lut_t(): ids(total_values, no_texture)
+	{}
+
+	[[nodiscard]] static blt::vec3 point_color(blt::i32 r, blt::i32 g, blt::i32 b);
+
+	[[nodiscard]] blt::u32* point(const blt::i32 r, const blt::i32 g, const blt::i32 b)
+	{
+		return ids.data() + index(r, g, b);
+	}
+
+	// unique texture ids stored around the color, the true closest textures are almost always among them
+	[[nodiscard]] std::vector<blt::u32> candidates(const blt::vec3& linear_rgb) const;
+
+	[[nodiscard]] std::vector<blt::u32>& data()
+	{
+		return ids;
+	}
+
+	[[nodiscard]] const std::vector<blt::u32>& data() const
+	{
+		return ids;
+	}
+
+private:
+	[[nodiscard]] static size_t index(const blt::i32 r, const blt::i32 g, const blt::i32 b)
+	{
+		return ((static_cast<size_t>(r) * resolution + g) * resolution + b) * point_textures;
+	}
+
+	std::vector<blt::u32> ids;
+};
+
+/**
+ * Luts for the current gpu resources. They take seconds to build so find() never blocks, it hands back nothing and
+ * starts a background build the first time a key is asked for. gpu_asset_manager clears these whenever it re-tints.
+ */
+class color_lut_cache_t
+{
+public:
+	using source_func_t = std::function<std::unique_ptr<sampler_interface_t>(const blt::vec3&, int)>;
+
+	color_lut_cache_t(): mutex{std::make_unique<std::mutex>()}
+	{}
+
+	std::shared_ptr<const color_lut_t> find(const color_lut_key_t& key, const source_func_t& source, const comparator_interface_t& comparator);
+
+	void publish(const color_lut_key_t& key, std::shared_ptr<const color_lut_t> lut);
+
+	// lets a failed or cancelled build be requested again
+	void abandon(const color_lut_key_t& key);
+
+	void clear();
+
+private:
+	struct entry_t
+	{
+		color_lut_key_t                    key;
+		std::shared_ptr<const color_lut_t> lut;
+	};
+
+	static constexpr size_t capacity = 4;
+
+	std::unique_ptr<std::mutex> mutex;
+	std::vector<entry_t>        entries;
+};
+
+#endif //COLOR_LUT_H
@@ -0,0 +1,88 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLOR_PLANE_H
+#define COLOR_PLANE_H
+
+#include <array>
+#include <vector>
+#include <blt/math/colors.h>
+#include <blt/math/vectors.h>
+
+struct image_t;
+
+enum class feature_space_t : blt::u32
+{
+	OKLAB,
+	LINEAR_RGB,
+	SRGB,
+	HSV
+};
+
+inline constexpr size_t feature_space_count = 4;
+
+// wraps a raw feature value back into a color of the space it was computed in, comparators rely on the color type
+blt::color_t make_feature_color(feature_space_t space, const blt::vec3& value);
+
+/**
+ * Structure of arrays copy of an image converted into one color space. Pixel indices match access_image() and alpha is
+ * kept in its own channel, so samplers never have to go back to the interleaved image data.
+ */
+struct color_plane_t
+{
+	blt::i32                          width  = 0;
+	blt::i32                          height = 0;
+	std::array<std::vector<float>, 3> channels;
+	std::vector<float>                alpha;
+
+	[[nodiscard]] blt::vec3 get(const blt::i32 x, const blt::i32 y) const
+	{
+		const auto index = static_cast<size_t>(y * width + x);
+		return blt::vec3{channels[0][index], channels[1][index], channels[2][index]};
+	}
+
+	[[nodiscard]] float get_alpha(const blt::i32 x, const blt::i32 y) const
+	{
+		return alpha[static_cast<size_t>(y * width + x)];
+	}
+};
+
+/**
+ * Converts count interleaved linear RGBA pixels into planar values of the given space, the same values
+ * from<linear_rgb_t>(pixel).as_*() produces. Uses AVX2 or SSE4.1 when the cpu supports them.
+ */
+void convert_pixels(feature_space_t space, const float* rgba, size_t count, float* c0, float* c1, float* c2, float* alpha);
+
+[[nodiscard]] color_plane_t convert_image(const image_t& image, feature_space_t space);
+
+/**
+ * Adds sqrt(sum over c of (query[c] - scale[c] * terms[c][i])^2) to scores[i] for count candidates, channels without terms
+ * are left out. The distance kernel behind the batch comparators, it rounds exactly like the same expression in scalar
+ * code so batch scores agree with compare(). Uses AVX or SSE4.1 when the cpu supports them.
+ */
+void accumulate_distances(const blt::vec3& query, const blt::vec3& scale, const std::array<const float*, 3>& terms, size_t count,
+						float* scores);
+
+/**
+ * Runs the scalar kernels and every vector path the cpu supports over a sweep of colors and compares them against the
+ * blt::color conversions the query side uses, allowing 1e-6 of error (relative for values above 1). Logs each space and
+ * path that drifted, true if everything matched.
+ */
+bool verify_color_kernels();
+
+#endif //COLOR_PLANE_H
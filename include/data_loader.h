@@ -20,7 +20,13 @@
 #define DATA_LOADER_H
 
 #include <asset_loader.h>
+#include <color_plane.h>
+#include <pixel_format.h>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <sql.h>
 #include <blt/math/colors.h>
 #include <blt/math/vectors.h>
@@ -36,31 +42,31 @@ blt::vec4 access_image(const image_t& image, blt::i32 x, blt::i32 y);
 struct sampler_interface_t
 {
 	virtual ~sampler_interface_t() = default;
-	[[nodiscard]] virtual std::vector<blt::color_t> get_values() const = 0;
+	// views the sampler's own storage, valid until the sampler is changed or destroyed
+	[[nodiscard]] virtual std::span<const blt::color_t> get_values() const = 0;
 };
 
 struct sampler_single_value_t final : sampler_interface_t
 {
-	explicit sampler_single_value_t(const blt::color_t value, blt::i32 samples = 1): value{value}, samples{samples}
+	explicit sampler_single_value_t(const blt::color_t value, blt::i32 samples = 1): values(std::max(samples, 0), value)
 	{}
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
-		std::vector<blt::color_t> values;
-		for (blt::i32 i = 0; i < samples; i++)
-			values.push_back(value);
 		return values;
 	}
 
-	blt::color_t value;
-	blt::i32 samples;
+	std::vector<blt::color_t> values;
 };
 
 struct sampler_oklab_op_t final : sampler_interface_t
 {
 	explicit sampler_oklab_op_t(const image_t& image, blt::i32 samples = 1);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	// the plane has to already be in this sampler's space
+	explicit sampler_oklab_op_t(const color_plane_t& plane, blt::i32 samples = 1);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return averages;
 	}
@@ -72,7 +78,10 @@ struct sampler_linear_rgb_op_t final : sampler_interface_t
 {
 	explicit sampler_linear_rgb_op_t(const image_t& image, blt::i32 samples = 1);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	// the plane has to already be in this sampler's space
+	explicit sampler_linear_rgb_op_t(const color_plane_t& plane, blt::i32 samples = 1);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return averages;
 	}
@@ -84,7 +93,10 @@ struct sampler_srgb_op_t final : sampler_interface_t
 {
 	explicit sampler_srgb_op_t(const image_t& image, blt::i32 samples = 1);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	// the plane has to already be in this sampler's space
+	explicit sampler_srgb_op_t(const color_plane_t& plane, blt::i32 samples = 1);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return averages;
 	}
@@ -96,7 +108,10 @@ struct sampler_hsv_op_t final : sampler_interface_t
 {
 	explicit sampler_hsv_op_t(const image_t& image, blt::i32 samples = 1);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	// the plane has to already be in this sampler's space
+	explicit sampler_hsv_op_t(const color_plane_t& plane, blt::i32 samples = 1);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return averages;
 	}
@@ -108,7 +123,9 @@ struct sampler_color_difference_oklab_t final : sampler_interface_t
 {
 	explicit sampler_color_difference_oklab_t(const image_t& image);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	explicit sampler_color_difference_oklab_t(const color_plane_t& plane);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return color_differences;
 	}
@@ -118,9 +135,11 @@ struct sampler_color_difference_oklab_t final : sampler_interface_t
 
 struct sampler_kernel_filter_oklab_t final : sampler_interface_t
 {
-	explicit sampler_kernel_filter_oklab_t(const image_t& image);
+	explicit sampler_kernel_filter_oklab_t(const image_t& image, blt::i32 size = 1);
+
+	explicit sampler_kernel_filter_oklab_t(const color_plane_t& plane, blt::i32 size = 1);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return kernel_averages;
 	}
@@ -132,7 +151,9 @@ struct sampler_color_difference_rgb_t final : sampler_interface_t
 {
 	explicit sampler_color_difference_rgb_t(const image_t& image);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	explicit sampler_color_difference_rgb_t(const color_plane_t& plane);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return color_differences;
 	}
@@ -142,9 +163,11 @@ struct sampler_color_difference_rgb_t final : sampler_interface_t
 
 struct sampler_kernel_filter_rgb_t final : sampler_interface_t
 {
-	explicit sampler_kernel_filter_rgb_t(const image_t& image);
+	explicit sampler_kernel_filter_rgb_t(const image_t& image, blt::i32 size = 1);
+
+	explicit sampler_kernel_filter_rgb_t(const color_plane_t& plane, blt::i32 size = 1);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return kernel_averages;
 	}
@@ -156,7 +179,9 @@ struct sampler_color_difference_srgb_t final : sampler_interface_t
 {
 	explicit sampler_color_difference_srgb_t(const image_t& image);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	explicit sampler_color_difference_srgb_t(const color_plane_t& plane);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return color_differences;
 	}
@@ -166,9 +191,11 @@ struct sampler_color_difference_srgb_t final : sampler_interface_t
 
 struct sampler_kernel_filter_srgb_t final : sampler_interface_t
 {
-	explicit sampler_kernel_filter_srgb_t(const image_t& image);
+	explicit sampler_kernel_filter_srgb_t(const image_t& image, blt::i32 size = 1);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	explicit sampler_kernel_filter_srgb_t(const color_plane_t& plane, blt::i32 size = 1);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return kernel_averages;
 	}
@@ -180,7 +207,9 @@ struct sampler_color_difference_hsv_t final : sampler_interface_t
 {
 	explicit sampler_color_difference_hsv_t(const image_t& image);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	explicit sampler_color_difference_hsv_t(const color_plane_t& plane);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return color_differences;
 	}
@@ -190,9 +219,11 @@ struct sampler_color_difference_hsv_t final : sampler_interface_t
 
 struct sampler_kernel_filter_hsv_t final : sampler_interface_t
 {
-	explicit sampler_kernel_filter_hsv_t(const image_t& image);
+	explicit sampler_kernel_filter_hsv_t(const image_t& image, blt::i32 size = 1);
+
+	explicit sampler_kernel_filter_hsv_t(const color_plane_t& plane, blt::i32 size = 1);
 
-	[[nodiscard]] std::vector<blt::color_t> get_values() const override
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
 	{
 		return kernel_averages;
 	}
@@ -200,6 +231,106 @@ struct sampler_kernel_filter_hsv_t final : sampler_interface_t
 	std::vector<blt::color_t> kernel_averages;
 };
 
+/**
+ * Everything the rankings sample from one converted plane, produced in a single pass over its pixels: every grid from
+ * 1x1 up to max_samples, the color difference and the kernel filter metric for a box of kernel_size pixels around every
+ * pixel. Values match the individual samplers.
+ */
+struct fused_sampler_t
+{
+	fused_sampler_t(const color_plane_t& plane, feature_space_t space, blt::i32 max_samples, blt::i32 kernel_size = 1);
+
+	[[nodiscard]] const blt::vec3& average() const
+	{
+		return grids.front().front();
+	}
+
+	// grids[samples - 1] holds samples * samples averages, in the order the matching sampler_*_op_t produces them
+	std::vector<std::vector<blt::vec3>> grids;
+	blt::vec3                           difference;
+	blt::vec3                           kernel;
+};
+
+// what a comparator derives from the candidates of a batch before scoring them
+enum class batch_terms_kind_t : blt::u32
+{
+	// sin(h)·s and cos(h)·s of hsv values
+	HSV_CHROMA,
+	// OkLab of the OkLCh values scaled by the comparator factors
+	WEIGHTED_OKLAB
+};
+
+/**
+ * Per candidate terms comparators derive from the values of a batch, kept next to the plane the batch views so they are
+ * worked out once rather than on every query. Terms are value major, term c of value j of candidate i is at
+ * j * count + i, so the distance kernels read them contiguously.
+ */
+class batch_terms_t
+{
+public:
+	using terms_t = std::array<std::vector<float>, 3>;
+
+	struct key_t
+	{
+		batch_terms_kind_t   kind = batch_terms_kind_t::HSV_CHROMA;
+		feature_space_t      space = feature_space_t::OKLAB;
+		size_t               count = 0;
+		std::array<float, 3> factors{};
+
+		bool operator==(const key_t&) const = default;
+	};
+
+	// terms for key, build runs the first time they are asked for. Safe to call from several ranking workers at once
+	[[nodiscard]] std::shared_ptr<const terms_t> get(const key_t& key, const std::function<terms_t()>& build);
+
+	// drops every cached term, for when the values they came from changed
+	void clear();
+
+private:
+	// only a few factor sets are in use at once, the least recently used is dropped first
+	static constexpr size_t max_entries = 4;
+
+	std::mutex                                                    mutex;
+	std::vector<std::pair<key_t, std::shared_ptr<const terms_t>>> entries;
+};
+
+/**
+ * Candidates for a batch comparison stored as structure of arrays, value j of candidate i lives at
+ * i * values_per_candidate + j in every channel. Values are in the given space.
+ */
+struct comparator_batch_t
+{
+	std::array<const float*, 3> channels{};
+	size_t                      count                = 0;
+	blt::i32                    values_per_candidate = 1;
+	feature_space_t             space                = feature_space_t::OKLAB;
+	// cache belonging to the values behind the batch, without one comparators derive their terms for this batch only
+	batch_terms_t*              terms                = nullptr;
+
+	[[nodiscard]] blt::vec3 get(const size_t candidate, const blt::i32 value) const
+	{
+		const auto index = candidate * values_per_candidate + value;
+		return blt::vec3{channels[0][index], channels[1][index], channels[2][index]};
+	}
+};
+
+// one candidate of a batch behind the sampler interface, for comparators without a batch implementation
+struct sampler_batch_value_t final : sampler_interface_t
+{
+	sampler_batch_value_t(const comparator_batch_t& batch, size_t candidate);
+
+	// moves to another candidate, reusing the storage of the values
+	void set_candidate(size_t candidate);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
+	{
+		return values;
+	}
+
+	const comparator_batch_t* batch;
+	std::vector<blt::color_t> values;
+};
+
 struct comparator_interface_t
 {
 	float factor0 = 1;
@@ -209,9 +340,35 @@ struct comparator_interface_t
 	virtual ~comparator_interface_t() = default;
 	virtual float compare(sampler_interface_t& s1, sampler_interface_t& s2) = 0;
 
+	/**
+	 * Scores the query against every candidate of the batch, the query taking the place of s1 in compare(). Writes
+	 * batch.count scores, each the same value compare() would give for that candidate.
+	 */
+	virtual void compare_batch(sampler_interface_t& query, const comparator_batch_t& batch, float* scores);
+
+	// comparators are handed to ranking workers as copies so the UI can keep editing the factors
+	[[nodiscard]] virtual std::unique_ptr<comparator_interface_t> clone() const = 0;
+
+	// true if compare() satisfies the triangle inequality, which lets rankings be answered from a vp_tree_t
+	[[nodiscard]] virtual bool is_metric() const
+	{
+		return false;
+	}
+
 	float compare(sampler_interface_t& s1, const blt::color_t point)
 	{
-		sampler_single_value_t value{point};
+		struct point_sampler_t final : sampler_interface_t
+		{
+			explicit point_sampler_t(const blt::color_t value): value{value}
+			{}
+
+			[[nodiscard]] std::span<const blt::color_t> get_values() const override
+			{
+				return {&value, 1};
+			}
+
+			blt::color_t value;
+		} value{point};
 		return compare(s1, value);
 	}
 };
@@ -219,32 +376,97 @@ struct comparator_interface_t
 struct comparator_euclidean_t final : comparator_interface_t
 {
 	float compare(sampler_interface_t& s1, sampler_interface_t& s2) override;
+
+	[[nodiscard]] std::unique_ptr<comparator_interface_t> clone() const override
+	{
+		return std::make_unique<comparator_euclidean_t>(*this);
+	}
+
+	[[nodiscard]] bool is_metric() const override
+	{
+		return true;
+	}
 };
 
 struct comparator_mean_sample_euclidean_t final : comparator_interface_t
 {
 	float compare(sampler_interface_t& s1, sampler_interface_t& s2) override;
+
+	void compare_batch(sampler_interface_t& query, const comparator_batch_t& batch, float* scores) override;
+
+	[[nodiscard]] std::unique_ptr<comparator_interface_t> clone() const override
+	{
+		return std::make_unique<comparator_mean_sample_euclidean_t>(*this);
+	}
+
+	[[nodiscard]] bool is_metric() const override
+	{
+		return true;
+	}
 };
 
 struct comparator_mean_sample_oklab_euclidean_t final : comparator_interface_t
 {
 	float compare(sampler_interface_t& s1, sampler_interface_t& s2) override;
+
+	void compare_batch(sampler_interface_t& query, const comparator_batch_t& batch, float* scores) override;
+
+	[[nodiscard]] std::unique_ptr<comparator_interface_t> clone() const override
+	{
+		return std::make_unique<comparator_mean_sample_oklab_euclidean_t>(*this);
+	}
+
+	[[nodiscard]] bool is_metric() const override
+	{
+		return true;
+	}
 };
 
 struct comparator_mean_sample_hsv_euclidean_t final : comparator_interface_t
 {
 	float compare(sampler_interface_t& input1, sampler_interface_t& input2) override;
+
+	void compare_batch(sampler_interface_t& query, const comparator_batch_t& batch, float* scores) override;
+
+	[[nodiscard]] std::unique_ptr<comparator_interface_t> clone() const override
+	{
+		return std::make_unique<comparator_mean_sample_hsv_euclidean_t>(*this);
+	}
 };
 
 struct comparator_nearest_sample_euclidean_t final : comparator_interface_t
 {
 	float compare(sampler_interface_t& s1, sampler_interface_t& s2) override;
+
+	[[nodiscard]] std::unique_ptr<comparator_interface_t> clone() const override
+	{
+		return std::make_unique<comparator_nearest_sample_euclidean_t>(*this);
+	}
 };
 
 struct image_t
 {
 	blt::i32 width, height;
-	std::vector<float> data;
+	pixel_format_t format = pixel_format_t::RGBA32F;
+	// RGBA pixels in format, read them through expand() or convert_image() rather than directly
+	std::vector<std::byte> pixels;
+	// ranking features computed when the assets were loaded, empty if they have to be computed at startup instead
+	std::vector<float> features;
+	// texture_blobs row holding the pixels, textures with the same blob are identical. 0 for databases from before blobs were shared
+	blt::i64 blob = 0;
+
+	[[nodiscard]] size_t pixel_count() const
+	{
+		return pixels.size() / bytes_per_pixel(format);
+	}
+
+	// every pixel as interleaved RGBA floats
+	[[nodiscard]] std::vector<float> expand() const
+	{
+		std::vector<float> values(pixel_count() * 4);
+		expand_pixels(format, pixels.data(), pixel_count(), values.data());
+		return values;
+	}
 
 	[[nodiscard]] auto get_default_sampler() const
 	{
@@ -254,17 +476,19 @@ struct image_t
 
 struct namespace_assets_t
 {
-	blt::hashmap_t<std::string, image_t> images;
-	blt::hashmap_t<std::string, image_t> non_solid_images;
-	blt::hashmap_t<std::string, biome_color_t> biome_colors;
-	blt::hashmap_t<std::string, blt::hashset_t<std::string>> tags;
-	blt::hashmap_t<std::string, blt::hashset_t<std::string>> block_to_textures;
+	string_map_t<image_t> images;
+	string_map_t<image_t> non_solid_images;
+	string_map_t<biome_color_t> biome_colors;
+	// tag -> blocks
+	string_map_t<blt::hashset_t<asset_id_t>> tags;
+	// block -> textures
+	string_map_t<blt::hashset_t<asset_id_t>> block_to_textures;
 };
 
 struct assets_t
 {
 	database_t* db = nullptr;
-	blt::hashmap_t<std::string, namespace_assets_t> assets;
+	string_map_t<namespace_assets_t> assets;
 	assets_t() = default;
 
 	explicit assets_t(database_t& db): db{&db}
@@ -278,19 +502,17 @@ struct assets_t
 		if (db == nullptr)
 			BLT_ABORT("Database is null. Did you forget to load it?");
 
-		auto stmt = db->prepare(sql);
-		return get_rows<Types...>(stmt);
+		return get_rows<Types...>(db->cached(sql));
 	}
 
 	template <typename... Types>
-	std::vector<std::tuple<Types...>> get_rows(statement_t& stmt)
+	std::vector<std::tuple<Types...>> get_rows(const statement_t& stmt)
 	{
 		if (db == nullptr)
 			BLT_ABORT("Database is null. Did you forget to load it?");
-		stmt.bind();
 		std::vector<std::tuple<Types...>> results;
-		while (stmt.execute().has_row())
-			results.push_back(stmt.fetch().get<Types...>());
+		for (auto row : stmt.rows<Types...>())
+			results.push_back(std::move(row));
 		return results;
 	}
 };
@@ -0,0 +1,61 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIXEL_FORMAT_H
+#define PIXEL_FORMAT_H
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+#include <blt/std/types.h>
+
+/*
+ * How the RGBA pixels of an image_t are stored. Everything that reads pixels expands them back into floats on the fly, a
+ * texture keeps its compact form on disk, in memory and in the gpu upload.
+ */
+enum class pixel_format_t : blt::u8
+{
+	// 16 bytes per pixel, the floats stbi_loadf produces
+	RGBA32F,
+	// 8 bytes per pixel, half floats of the same values
+	RGBA16F,
+	// 4 bytes per pixel, color is gamma encoded the way stbi_loadf decodes it and alpha is linear. Lossless for png textures
+	SRGB8,
+	// 4 bytes per pixel, every channel is just divided by 255. What an SRGB8 texture becomes once it is prepared for display,
+	// never stored since it has the same size as SRGB8
+	UNORM8
+};
+
+[[nodiscard]] size_t bytes_per_pixel(pixel_format_t format);
+
+// the format the database stored a width x height texture in, told apart by the size of its blob
+[[nodiscard]] std::optional<pixel_format_t> stored_pixel_format(size_t bytes, blt::i32 width, blt::i32 height);
+
+// the format a texture of the given format holds once its values are no longer linear, see prepare_texture_image()
+[[nodiscard]] pixel_format_t display_pixel_format(pixel_format_t format);
+
+// packs count interleaved RGBA float pixels, values outside what the format holds are clamped
+[[nodiscard]] std::vector<std::byte> encode_pixels(pixel_format_t format, const float* rgba, size_t count);
+
+// unpacks count pixels into interleaved RGBA floats
+void expand_pixels(pixel_format_t format, const std::byte* pixels, size_t count, float* rgba);
+
+// unpacks count pixels straight into separate channels
+void expand_pixels(pixel_format_t format, const std::byte* pixels, size_t count, float* r, float* g, float* b, float* alpha);
+
+#endif //PIXEL_FORMAT_H
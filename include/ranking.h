@@ -0,0 +1,304 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <render.h>
+#include <blt/math/colors.h>
+
+struct min_max_t
+{
+	float min = std::numeric_limits<float>::max(), max = std::numeric_limits<float>::min();
+
+	void with(const float v)
+	{
+		if (v < min)
+			min = v;
+		if (v > max)
+			max = v;
+	}
+
+	[[nodiscard]] float scale() const
+	{
+		return std::abs(max - min);
+	}
+
+	// [[nodiscard]] float normalize(const float f) const { return f; }
+	[[nodiscard]] float normalize(const float f) const
+	{
+		return (f - min) / scale();;
+	}
+
+	void reset()
+	{
+		min = std::numeric_limits<float>::max();
+		max = std::numeric_limits<float>::min();
+	}
+};
+
+struct ordering_t
+{
+	asset_id_t         id;
+	const gpu_image_t* texture;
+	blt::color_t       average;
+	float              dist_avg;
+	float              dist_color;
+	float              dist_kernel;
+
+	ordering_t(const asset_id_t&   id,
+			   const gpu_image_t*  texture,
+			   const blt::color_t& average,
+			   const float         dist_avg,
+			   const float         dist_color,
+			   const float         dist_kernel) : id{id},
+												  texture{texture},
+												  average{average},
+												  dist_avg{dist_avg},
+												  dist_color{dist_color},
+												  dist_kernel{dist_kernel}
+	{}
+};
+
+/**
+ * Everything a ranking depends on. Two queries with equal keys produce the same ordering, so the result can be reused.
+ * The resource generation changes whenever the gpu resources are rebuilt or re-tinted for a new biome.
+ */
+struct ranking_key_t
+{
+	std::array<float, 3> color{};
+	std::string          block;
+	int                  color_mode      = 0;
+	int                  comparator_mode = 0;
+	int                  samples         = 1;
+	int                  kernel_size     = 1;
+	std::array<float, 3> factors{};
+	std::array<float, 3> weights{};
+	bool                 include_non_solid   = false;
+	bool                 enable_noise        = false;
+	bool                 use_color_lut       = false;
+	// cutoffs filter on the noise distances, which only full scans produce
+	bool                 enable_cutoffs      = false;
+	// how many textures are displayed, rankings answered from an index only hold this many
+	int                  limit               = 0;
+	// bumped by the tab whenever the set of excluded textures changes
+	size_t               filter_generation   = 0;
+	size_t               resource_generation = 0;
+
+	bool operator==(const ranking_key_t&) const = default;
+};
+
+struct ranking_result_t
+{
+	std::vector<ordering_t> ordering;
+	min_max_t               avg_difference_vals;
+	min_max_t               color_difference_vals;
+	min_max_t               kernel_difference_vals;
+};
+
+/**
+ * Small most-recently-used cache of rankings. Lookups are linear since a tab only ever holds a handful of queries
+ * (one per color in the color wheel, plus whatever the user toggles back and forth between).
+ */
+class ranking_cache_t
+{
+public:
+	explicit ranking_cache_t(const size_t capacity = 8): capacity{capacity}
+	{}
+
+	[[nodiscard]] const ranking_result_t* find(const ranking_key_t& key)
+	{
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			if (entries[i].first != key)
+				continue;
+			// move to the front so the least recently used entry is always at the back
+			if (i != 0)
+				std::rotate(entries.begin(), entries.begin() + static_cast<blt::ptrdiff_t>(i), entries.begin() + static_cast<blt::ptrdiff_t>(i) + 1);
+			return &entries.front().second;
+		}
+		return nullptr;
+	}
+
+	const ranking_result_t& insert(ranking_key_t key, ranking_result_t result)
+	{
+		if (entries.size() >= capacity)
+			entries.pop_back();
+		entries.emplace(entries.begin(), std::move(key), std::move(result));
+		return entries.front().second;
+	}
+
+	void clear()
+	{
+		entries.clear();
+	}
+
+private:
+	size_t                                                 capacity;
+	std::vector<std::pair<ranking_key_t, ranking_result_t>> entries;
+};
+
+struct ranking_job_t
+{
+	// returning an empty optional means the job noticed it was cancelled or its inputs went stale
+	using work_t = std::function<std::optional<ranking_result_t>(const std::atomic_bool& cancelled)>;
+
+	ranking_job_t(ranking_key_t key, work_t work): key{std::move(key)}, work{std::move(work)}
+	{}
+
+	ranking_key_t     key;
+	work_t            work;
+	ranking_result_t  result;
+	std::atomic_bool  cancelled = false;
+	std::atomic_bool  finished  = false;
+};
+
+class ranking_pool_t
+{
+public:
+	explicit ranking_pool_t(size_t thread_count = std::max(1u, std::thread::hardware_concurrency() / 2));
+
+	ranking_pool_t(const ranking_pool_t&) = delete;
+
+	ranking_pool_t& operator=(const ranking_pool_t&) = delete;
+
+	std::shared_ptr<ranking_job_t> submit(ranking_key_t key, ranking_job_t::work_t work);
+
+	/**
+	 * Low priority work that is only picked up while no ranking is waiting. It holds the same shared lock on the gpu
+	 * resources as rankings and is cancelled the same way. Dropped entirely when the pool has no workers.
+	 */
+	void submit_background(std::function<void(const std::atomic_bool& cancelled)> task);
+
+	/**
+	 * Cancels every queued and running job then takes exclusive ownership of the gpu resources. Hold the returned lock
+	 * while re-tinting, rebuilding or destroying gpu_resources so no worker reads textures as they change.
+	 */
+	[[nodiscard]] std::unique_lock<std::shared_mutex> lock_resources();
+
+	~ranking_pool_t();
+
+private:
+	void run();
+
+	std::vector<std::thread>                   threads;
+	std::mutex                                 queue_mutex;
+	std::condition_variable                    queue_cv;
+	std::deque<std::shared_ptr<ranking_job_t>> queue;
+	std::deque<std::shared_ptr<ranking_job_t>> background;
+	std::vector<std::shared_ptr<ranking_job_t>> running;
+	std::shared_mutex                          resource_mutex;
+	bool                                       stop = false;
+};
+
+ranking_pool_t& get_ranking_pool();
+
+/**
+ * Double buffered ranking output. The tab keeps drawing the last finished ranking while at most one newer query is in
+ * flight, submitting another query cancels the one being worked on.
+ */
+class ranking_slot_t
+{
+public:
+	// false if the key is already displayed or already being computed
+	[[nodiscard]] bool wants(const ranking_key_t& key) const
+	{
+		return !((displayed && *displayed == key) || (job && job->key == key));
+	}
+
+	void show(const ranking_key_t& key)
+	{
+		cancel();
+		displayed = key;
+	}
+
+	void submit(std::shared_ptr<ranking_job_t> new_job)
+	{
+		cancel();
+		job = std::move(new_job);
+	}
+
+	// hands back the in flight job exactly once after it finishes, the caller is responsible for swapping in its result
+	std::shared_ptr<ranking_job_t> take_finished()
+	{
+		if (!job || !job->finished.load(std::memory_order_acquire))
+			return nullptr;
+		auto done = std::move(job);
+		job.reset();
+		if (done->cancelled)
+			return nullptr;
+		displayed = done->key;
+		return done;
+	}
+
+	void cancel()
+	{
+		if (job)
+			job->cancelled = true;
+		job.reset();
+	}
+
+	void reset()
+	{
+		cancel();
+		displayed.reset();
+	}
+
+	ranking_slot_t() = default;
+
+	ranking_slot_t(const ranking_slot_t&) = delete;
+
+	ranking_slot_t(ranking_slot_t&&) noexcept = default;
+
+	ranking_slot_t& operator=(const ranking_slot_t&) = delete;
+
+	ranking_slot_t& operator=(ranking_slot_t&& move) noexcept
+	{
+		cancel();
+		displayed = std::move(move.displayed);
+		job       = std::move(move.job);
+		return *this;
+	}
+
+	~ranking_slot_t()
+	{
+		cancel();
+	}
+
+private:
+	std::optional<ranking_key_t>   displayed;
+	std::shared_ptr<ranking_job_t> job;
+};
+
+#endif //RANKING_H
@@ -20,6 +20,9 @@
 #define RENDER_H
 
 #include <data_loader.h>
+#include <texture_features.h>
+#include <texture_index.h>
+#include <color_lut.h>
 #include <blt/gfx/texture.h>
 
 struct block_picker_data_t;
@@ -28,13 +31,27 @@ struct gpu_image_t
 {
 	gpu_image_t() = default;
 
-	gpu_image_t(image_t image, std::unique_ptr<blt::gfx::texture_gl2D> texture): image(std::move(image)), texture(std::move(texture))
+	gpu_image_t(image_t image, std::shared_ptr<blt::gfx::texture_gl2D> texture): image(std::move(image)), texture(std::move(texture))
 	{
 
 	}
 
 	image_t image;
-	std::unique_ptr<blt::gfx::texture_gl2D> texture;
+	// shared by every texture with the same blob, until one of them is tinted and gets its own
+	std::shared_ptr<blt::gfx::texture_gl2D> texture;
+	// index of this texture in the feature store
+	size_t feature_id = 0;
+};
+
+struct texture_ref_t
+{
+	std::string namespace_str;
+	std::string name;
+	// namespace:name, shown to the user and what the texture order hash is taken over
+	std::string full_name;
+	// what rankings and control lists refer to textures by
+	asset_id_t id;
+	const gpu_image_t* image;
 };
 
 class gpu_asset_manager
@@ -47,11 +64,53 @@ public:
 	blt::hashmap_t<std::string, blt::hashmap_t<std::string, gpu_image_t>> non_solid_resources;
 
 	std::vector<block_picker_data_t> get_icon_render_list();
+
+	// every texture in feature id order, solid textures come first
+	[[nodiscard]] const std::vector<texture_ref_t>& get_textures() const
+	{
+		return textures;
+	}
+
+	[[nodiscard]] size_t get_solid_count() const
+	{
+		return solid_count;
+	}
+
+	texture_feature_store_t features;
+	texture_index_cache_t indexes;
+	color_lut_cache_t luts;
     
     void update_textures(biome_color_t color);
-    
+
+	// changes every time the textures are rebuilt or re-tinted, anything derived from texture data must be recomputed
+	[[nodiscard]] size_t get_generation() const
+	{
+		return generation;
+	}
+
+	[[nodiscard]] const biome_color_t& get_biome() const
+	{
+		return biome;
+	}
+
+	// identifies the feature id order, anything stored on disk by id is only valid for the same hash
+	[[nodiscard]] size_t get_texture_order_hash() const
+	{
+		return texture_order_hash;
+	}
+
+	[[nodiscard]] database_t* get_database() const
+	{
+		return assets->db;
+	}
+
     private:
         assets_t* assets;
+        size_t generation = 0;
+        std::vector<texture_ref_t> textures;
+        size_t solid_count = 0;
+        size_t texture_order_hash = 0;
+        biome_color_t biome{};
 };
 
 #endif //RENDER_H
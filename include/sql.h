@@ -19,10 +19,17 @@
 #ifndef SQL_H
 #define SQL_H
 
+#include <chrono>
 #include <cstring>
+#include <iterator>
+#include <list>
+#include <optional>
+#include <span>
 #include <sqlite3.h>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <blt/iterator/enumerate.h>
@@ -61,6 +68,10 @@ public:
 	explicit column_t(sqlite3_stmt* statement): statement{statement}
 	{}
 
+	/**
+	 * std::string_view and std::span<const std::byte> point straight into sqlite's copy of the cell, they stay valid until
+	 * the statement is stepped again, reset or finalized. Everything else is a copy.
+	 */
 	template <typename T>
 	auto get(const int col) const -> decltype(auto)
 	{
@@ -80,9 +91,20 @@ public:
 		} else if constexpr (std::is_same_v<Decay, float>)
 		{
 			return static_cast<float>(sqlite3_column_double(statement, col));
-		} else if constexpr (std::is_same_v<Decay, std::string> || std::is_same_v<Decay, std::string_view> || std::is_same_v<Decay, char*>)
+		} else if constexpr (std::is_same_v<Decay, std::string> || std::is_same_v<Decay, std::string_view>)
+		{
+			// the text has to be asked for before its size, asking for the size first can convert it afterwards
+			const auto text = reinterpret_cast<const char*>(sqlite3_column_text(statement, col));
+			if (text == nullptr)
+				return T{};
+			return T{text, static_cast<size_t>(sqlite3_column_bytes(statement, col))};
+		} else if constexpr (std::is_same_v<Decay, char*>)
 		{
 			return T{reinterpret_cast<const char*>(sqlite3_column_text(statement, col))};
+		} else if constexpr (std::is_same_v<Decay, std::span<const std::byte>>)
+		{
+			const auto data = static_cast<const std::byte*>(sqlite3_column_blob(statement, col));
+			return T{data, static_cast<size_t>(sqlite3_column_bytes(statement, col))};
 		} else
 		{
 			return static_cast<const std::remove_pointer_t<T>*>(sqlite3_column_blob(statement, col));
@@ -110,6 +132,16 @@ private:
 	sqlite3_stmt* statement;
 };
 
+/**
+ * How text and blobs are handed to sqlite. COPY is always safe, sqlite takes its own copy while binding. BORROW skips the
+ * copy, the caller guarantees the bound data outlives every step of the statement until it is bound again.
+ */
+enum class bind_mode_t
+{
+	COPY,
+	BORROW
+};
+
 class column_binder_t
 {
 public:
@@ -117,10 +149,11 @@ public:
 	{}
 
 	template <typename T>
-	int bind(const T& type, int col)
+	int bind(const T& type, int col, const bind_mode_t mode = bind_mode_t::COPY)
 	{
 		static_assert(!std::is_rvalue_reference_v<T>, "Lifetime of object must outlive its usage!");
 		using Decay = std::decay_t<T>;
+		const auto destructor = mode == bind_mode_t::BORROW ? SQLITE_STATIC : SQLITE_TRANSIENT;
 		if constexpr (std::is_same_v<Decay, bool> || std::is_integral_v<Decay>)
 		{
 			if constexpr (sizeof(Decay) == 8)
@@ -135,17 +168,13 @@ public:
 			return sqlite3_bind_null(statement, col);
 		} else if constexpr (std::is_same_v<Decay, std::string> || std::is_same_v<Decay, std::string_view>)
 		{
-			auto str_copy = new char[type.size()];
-			std::memcpy(str_copy, type.data(), type.size());
-			return sqlite3_bind_text(statement, col, str_copy, type.size(), [](void* ptr) {
-				delete[] static_cast<char*>(ptr);
-			});
+			return sqlite3_bind_text64(statement, col, type.data(), type.size(), destructor, SQLITE_UTF8);
 		} else if constexpr (std::is_same_v<Decay, char*> || std::is_same_v<Decay, const char*>)
 		{
-			return sqlite3_bind_text(statement, col, type, -1, nullptr);
+			return sqlite3_bind_text(statement, col, type, -1, destructor);
 		} else
 		{
-			return sqlite3_bind_blob64(statement, col, type.data(), type.size(), nullptr);
+			return sqlite3_bind_blob64(statement, col, type.data(), type.size(), destructor);
 		}
 	}
 
@@ -163,29 +192,36 @@ public:
 	 * Indexes start at 1 for the left most template parameter
 	 */
 	template <typename T>
-	int bind(const T& type, int col)
+	int bind(const T& type, int col, const bind_mode_t mode = bind_mode_t::COPY)
 	{
-		return column_binder_t{statement}.bind(type, col);
+		return column_binder_t{statement}.bind(type, col, mode);
 	}
 
 	template <typename T>
-	int bind(const T& type, const std::string& name)
+	int bind(const T& type, const std::string& name, const bind_mode_t mode = bind_mode_t::COPY)
 	{
 		auto index = sqlite3_bind_parameter_index(statement, name.c_str());
-		return column_binder_t{statement}.bind(type, index);
+		return column_binder_t{statement}.bind(type, index, mode);
 	}
 
 	template <typename... Types>
 	int bind_all(const Types&... types)
 	{
-		return bind_internal<Types...>(std::index_sequence_for<Types...>(), types...);
+		return bind_internal<Types...>(std::index_sequence_for<Types...>(), bind_mode_t::COPY, types...);
+	}
+
+	// bind_all() without copying text or blobs, for values that are alive until the statement has been executed
+	template <typename... Types>
+	int borrow_all(const Types&... types)
+	{
+		return bind_internal<Types...>(std::index_sequence_for<Types...>(), bind_mode_t::BORROW, types...);
 	}
 
 private:
 	template <typename... Types, size_t... Indices>
-	int bind_internal(std::index_sequence<Indices...>, const Types&... types)
+	int bind_internal(std::index_sequence<Indices...>, const bind_mode_t mode, const Types&... types)
 	{
-		return ((bind<Types>(types, Indices + 1) != SQLITE_OK) | ...);
+		return ((bind<Types>(types, Indices + 1, mode) != SQLITE_OK) | ...);
 	}
 
 	sqlite3_stmt* statement;
@@ -220,6 +256,9 @@ private:
 	int error_code = 0;
 };
 
+template <typename... Types>
+class row_range_t;
+
 class statement_t
 {
 public:
@@ -253,6 +292,11 @@ public:
 		return column_t{statement};
 	}
 
+	// the rows of the statement from the first, as bound. See row_range_t, the statement has to outlive the range so
+	// never call this on a temporary like db.prepare(...).rows<...>()
+	template <typename... Types>
+	[[nodiscard]] row_range_t<Types...> rows() const;
+
 	~statement_t();
 
 private:
@@ -260,6 +304,93 @@ private:
 	sqlite3* db;
 };
 
+/**
+ * Input range over the rows of a statement. The statement is stepped as the range is walked and a row is only decoded when
+ * the iterator is dereferenced, so a result of any size is streamed in constant memory. Views in a row are valid until the
+ * next increment. The statement is reset once the range is gone, stopping early leaves nothing open.
+ */
+template <typename... Types>
+class row_range_t
+{
+public:
+	class iterator
+	{
+	public:
+		using value_type = std::tuple<Types...>;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() = default;
+
+		explicit iterator(const statement_t* statement): statement{statement}
+		{
+			step();
+		}
+
+		value_type operator*() const
+		{
+			return statement->fetch().template get<Types...>();
+		}
+
+		iterator& operator++()
+		{
+			step();
+			return *this;
+		}
+
+		void operator++(int)
+		{
+			step();
+		}
+
+		bool operator==(std::default_sentinel_t) const
+		{
+			return statement == nullptr;
+		}
+
+	private:
+		// errors end the range the same way running out of rows does
+		void step()
+		{
+			if (!statement->execute().has_row())
+				statement = nullptr;
+		}
+
+		const statement_t* statement = nullptr;
+	};
+
+	explicit row_range_t(const statement_t& statement): statement{&statement}
+	{}
+
+	row_range_t(const row_range_t&) = delete;
+
+	row_range_t& operator=(const row_range_t&) = delete;
+
+	iterator begin() const
+	{
+		return iterator{statement};
+	}
+
+	[[nodiscard]] std::default_sentinel_t end() const
+	{
+		return {};
+	}
+
+	~row_range_t()
+	{
+		statement->bind();
+	}
+
+private:
+	const statement_t* statement;
+};
+
+template <typename... Types>
+row_range_t<Types...> statement_t::rows() const
+{
+	sqlite3_reset(statement);
+	return row_range_t<Types...>{*this};
+}
+
 class table_builder_t;
 
 class table_column_builder_t
@@ -395,6 +526,13 @@ public:
 		return *this;
 	}
 
+	// rows are stored in the primary key's b-tree directly, for narrow tables that are only ever looked up by their key
+	table_builder_t& without_rowid()
+	{
+		rowid = false;
+		return *this;
+	}
+
 	statement_t build();
 
 private:
@@ -403,6 +541,7 @@ private:
 	std::vector<detail::foreign_key_t> foreign_keys{};
 	sqlite3* db;
 	std::string name{};
+	bool rowid = true;
 };
 
 class statement_builder_t
@@ -420,14 +559,62 @@ private:
 	sqlite3* db;
 };
 
+/**
+ * Incremental read access to a single blob cell. Bytes are copied straight from the database pages into the caller's memory,
+ * without sqlite materialising the whole value first the way sqlite3_column_blob does.
+ */
+class blob_reader_t
+{
+public:
+	blob_reader_t(sqlite3* db, const std::string& table, const std::string& column, sqlite3_int64 row);
+
+	blob_reader_t(const blob_reader_t& copy) = delete;
+
+	blob_reader_t(blob_reader_t&& move) noexcept: blob{std::exchange(move.blob, nullptr)}
+	{}
+
+	blob_reader_t& operator=(const blob_reader_t&) = delete;
+
+	blob_reader_t& operator=(blob_reader_t&& move) noexcept
+	{
+		blob = std::exchange(move.blob, blob);
+		return *this;
+	}
+
+	// points the reader at another row of the same table and column, much cheaper than opening a new reader
+	bool reopen(sqlite3_int64 row);
+
+	[[nodiscard]] bool valid() const
+	{
+		return blob != nullptr;
+	}
+
+	[[nodiscard]] size_t size() const
+	{
+		return blob == nullptr ? 0 : static_cast<size_t>(sqlite3_blob_bytes(blob));
+	}
+
+	// copies bytes bytes starting at offset into destination, false if the range is not inside the blob
+	bool read(void* destination, size_t bytes, size_t offset = 0) const;
+
+	~blob_reader_t();
+
+private:
+	sqlite3_blob* blob = nullptr;
+};
+
 class database_t
 {
 public:
+	// statements kept prepared per database, the least recently used one is finalized beyond this
+	static constexpr size_t statement_cache_size = 64;
+
 	explicit database_t(const std::string& file);
 
 	database_t(const database_t& copy) = delete;
 
-	database_t(database_t&& move) noexcept: db{std::exchange(move.db, nullptr)}
+	database_t(database_t&& move) noexcept: db{std::exchange(move.db, nullptr)}, statements{std::exchange(move.statements, {})},
+											statement_index{std::exchange(move.statement_index, {})}
 	{}
 
 	database_t& operator=(const database_t&) = delete;
@@ -435,6 +622,8 @@ public:
 	database_t& operator=(database_t&& move) noexcept
 	{
 		db = std::exchange(move.db, db);
+		statements.swap(move.statements);
+		statement_index.swap(move.statement_index);
 		return *this;
 	}
 
@@ -443,20 +632,143 @@ public:
 		return statement_t{db, stmt};
 	}
 
+	/**
+	 * Prepared statement for sql out of this database's cache, only the first use of some sql pays for sqlite3_prepare. It
+	 * comes back reset, ready to be bound. The reference stays valid until statement_cache_size other statements have been
+	 * cached after it. Run it to the end or re-fetch it, a statement left partway through its rows keeps its read open.
+	 */
+	[[nodiscard]] const statement_t& cached(const std::string& sql) const;
+
+	// read only, the blob cell is looked up by the rowid of its row
+	[[nodiscard]] blob_reader_t open_blob(const std::string& table, const std::string& column, const sqlite3_int64 row) const
+	{
+		return blob_reader_t{db, table, column, row};
+	}
+
 	[[nodiscard]] statement_builder_t builder() const
 	{
 		return statement_builder_t{db};
 	}
 
+	// path of the main database file, empty for in memory and temporary databases
+	[[nodiscard]] std::string get_file() const
+	{
+		const auto file = sqlite3_db_filename(db, "main");
+		return file == nullptr ? std::string{} : std::string{file};
+	}
+
 	[[nodiscard]] auto get_error() const
 	{
 		return sqlite3_errmsg(db);
 	}
 
+	// rowid of the last row inserted through this connection
+	[[nodiscard]] sqlite3_int64 last_insert_id() const
+	{
+		return sqlite3_last_insert_rowid(db);
+	}
+
+	// runs one or more statements that produce no rows, logging the error if any fail
+	bool exec(const std::string& sql) const; // NOLINT
+
+	// value of a pragma as text, empty if the pragma could not be read
+	[[nodiscard]] std::optional<std::string> get_pragma(const std::string& pragma) const;
+
 	~database_t();
 
 private:
 	sqlite3* db = nullptr;
+	// most recently used first. List nodes never move, so the index keys view straight into them
+	mutable std::list<std::pair<std::string, statement_t>> statements;
+	mutable std::unordered_map<std::string_view, std::list<std::pair<std::string, statement_t>>::iterator> statement_index;
+};
+
+/**
+ * Opens a transaction for its lifetime. Anything not committed when it goes out of scope is rolled back.
+ */
+class transaction_t
+{
+public:
+	explicit transaction_t(const database_t& db);
+
+	transaction_t(const transaction_t& copy) = delete;
+
+	transaction_t& operator=(const transaction_t&) = delete;
+
+	bool commit();
+
+	void rollback();
+
+	[[nodiscard]] bool is_active() const
+	{
+		return active;
+	}
+
+	~transaction_t();
+
+private:
+	const database_t* db;
+	bool active = false;
+};
+
+struct ingest_settings_t
+{
+	// rows written before the open transaction is committed and a new one started
+	size_t batch_size = 4096;
+	std::string journal_mode = "MEMORY";
+	std::string synchronous = "OFF";
+	// only takes effect on a database that has no tables yet, an existing one keeps its page size since changing it
+	// would take a VACUUM
+	int page_size = 4096;
+	// negative values are in KiB, as with the pragma
+	int cache_size = -65536;
+};
+
+/**
+ * Write mode for building a database in one go. Rows are grouped into transactions of settings.batch_size and the
+ * ingest pragmas are applied until it is destroyed, at which point the previous journal mode, synchronous level and cache
+ * size are restored. Work is split into named phases which each report their rows per second when they end. The last
+ * batch is only committed by finish(), an ingest destroyed without it (an exception or an early return) rolls that batch
+ * back like transaction_t does.
+ */
+class bulk_ingest_t
+{
+public:
+	explicit bulk_ingest_t(database_t& db, ingest_settings_t settings = {});
+
+	bulk_ingest_t(const bulk_ingest_t& copy) = delete;
+
+	bulk_ingest_t& operator=(const bulk_ingest_t&) = delete;
+
+	// ends the current phase, if any
+	void begin_phase(std::string name);
+
+	void end_phase();
+
+	// executes a bound insert, counting it towards the current phase and batch
+	[[jetbrains::has_side_effects]] statement_result_t execute(const statement_t& stmt); // NOLINT
+
+	// commits everything written so far without ending the phase, for schema changes between inserts
+	void flush();
+
+	// ends the phase and commits the open batch, nothing written afterwards is part of the ingest
+	void finish();
+
+	~bulk_ingest_t();
+
+private:
+	database_t& db;
+	ingest_settings_t settings;
+	std::optional<transaction_t> transaction;
+	std::string old_journal_mode;
+	std::string old_synchronous;
+	std::string old_cache_size;
+
+	std::optional<std::string> phase;
+	std::chrono::steady_clock::time_point phase_start;
+	size_t phase_rows = 0;
+	size_t batch_rows = 0;
+	bool finished = false;
 };
 
 #endif //SQL_H
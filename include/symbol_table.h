@@ -0,0 +1,117 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <deque>
+#include <functional>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <blt/std/hashmap.h>
+#include <blt/std/types.h>
+
+// an interned string, two symbols are equal exactly when their strings are
+enum class symbol_t : blt::u32
+{};
+
+// namespace:key, how namespaces, models, textures and blocks are referred to once they are loaded
+struct asset_id_t
+{
+	symbol_t namespace_id{};
+	symbol_t key_id{};
+
+	bool operator==(const asset_id_t&) const = default;
+};
+
+template <>
+struct std::hash<asset_id_t>
+{
+	size_t operator()(const asset_id_t& id) const noexcept
+	{
+		return std::hash<blt::u64>{}(static_cast<blt::u64>(id.namespace_id) << 32 | static_cast<blt::u64>(id.key_id));
+	}
+};
+
+// lets maps keyed on std::string be searched with a std::string_view without building a temporary string
+struct string_hash_t
+{
+	using is_transparent = void;
+
+	size_t operator()(const std::string_view value) const noexcept
+	{
+		return std::hash<std::string_view>{}(value);
+	}
+};
+
+template <typename V>
+using string_map_t = blt::hashmap_t<std::string, V, string_hash_t, std::equal_to<>>;
+using string_set_t = blt::hashset_t<std::string, string_hash_t, std::equal_to<>>;
+
+// map[key] for a view, a string is only built for keys the map does not have yet
+template <typename V>
+V& find_or_emplace(string_map_t<V>& map, const std::string_view key)
+{
+	if (const auto found = map.find(key); found != map.end())
+		return found->second;
+	return map.emplace(std::string{key}, V{}).first->second;
+}
+
+/**
+ * Process wide table of interned names. Symbols are never removed, so the views handed out stay valid for as long as the
+ * program runs. Safe to use from any thread, lookups only take a shared lock.
+ */
+class symbol_table_t
+{
+public:
+	symbol_t intern(std::string_view name);
+
+	asset_id_t intern(std::string_view namespace_str, std::string_view key);
+
+	// namespace:key, names without a namespace are in minecraft
+	asset_id_t intern_full(std::string_view full_name);
+
+	// lookups never add to the table, a name that was never interned can't be part of anything loaded
+	[[nodiscard]] std::optional<symbol_t> find(std::string_view name) const;
+
+	[[nodiscard]] std::optional<asset_id_t> find(std::string_view namespace_str, std::string_view key) const;
+
+	[[nodiscard]] std::optional<asset_id_t> find_full(std::string_view full_name) const;
+
+	[[nodiscard]] std::string_view name(symbol_t symbol) const;
+
+	[[nodiscard]] std::string full_name(const asset_id_t& id) const;
+
+	[[nodiscard]] size_t size() const;
+
+private:
+	symbol_t intern_locked(std::string_view name);
+
+	[[nodiscard]] std::optional<symbol_t> find_locked(std::string_view name) const;
+
+	mutable std::shared_mutex mutex;
+	// a deque never moves its elements, the map keys view straight into it
+	std::deque<std::string>                    names;
+	blt::hashmap_t<std::string_view, symbol_t> symbols;
+};
+
+symbol_table_t& get_symbol_table();
+
+#endif //SYMBOL_TABLE_H
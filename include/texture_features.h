@@ -0,0 +1,195 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTURE_FEATURES_H
+#define TEXTURE_FEATURES_H
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <color_plane.h>
+#include <data_loader.h>
+
+// converts a freshly decoded texture to what gets uploaded to the gpu, which is also what the rankings sample
+void prepare_texture_image(image_t& image, bool solid);
+
+/**
+ * Structure of arrays storage for one feature over every texture. Each channel is a single contiguous float array
+ * with values_per_texture entries per texture, laid out texture after texture.
+ */
+class feature_plane_t
+{
+public:
+	feature_plane_t() = default;
+
+	feature_plane_t(size_t texture_count, blt::i32 values_per_texture);
+
+	void set(size_t texture, const std::vector<blt::color_t>& values);
+
+	void set(size_t texture, const std::vector<blt::vec3>& values);
+
+	// values are interleaved, three floats per value
+	void set(size_t texture, const float* values);
+
+	// setting values leaves the comparator terms derived from them in place, this drops them once a texture changed
+	void clear_terms() const
+	{
+		if (terms)
+			terms->clear();
+	}
+
+	[[nodiscard]] blt::vec3 get(const size_t texture, const size_t value) const
+	{
+		const auto index = texture * per_texture + value;
+		return blt::vec3{channels[0][index], channels[1][index], channels[2][index]};
+	}
+
+	[[nodiscard]] const float* channel(const size_t c) const
+	{
+		return channels[c].data();
+	}
+
+	[[nodiscard]] blt::i32 values_per_texture() const
+	{
+		return per_texture;
+	}
+
+	// the first count textures as candidates of a batch comparison
+	[[nodiscard]] comparator_batch_t batch(const feature_space_t space, const size_t count) const
+	{
+		return comparator_batch_t{
+			{channels[0].data(), channels[1].data(), channels[2].data()}, std::min(count, textures), per_texture, space, terms.get()
+		};
+	}
+
+	[[nodiscard]] size_t texture_count() const
+	{
+		return textures;
+	}
+
+	[[nodiscard]] bool empty() const
+	{
+		return textures == 0;
+	}
+
+private:
+	size_t                            textures    = 0;
+	blt::i32                          per_texture = 0;
+	std::array<std::vector<float>, 3> channels;
+	std::unique_ptr<batch_terms_t>    terms = std::make_unique<batch_terms_t>();
+};
+
+// exposes one texture's precomputed values through the sampler interface so they can be handed to any comparator
+struct sampler_feature_t final : sampler_interface_t
+{
+	sampler_feature_t(const feature_plane_t& plane, size_t texture, feature_space_t space);
+
+	// moves to another texture of the same plane, reusing the storage of the values
+	void set_texture(size_t texture);
+
+	[[nodiscard]] std::span<const blt::color_t> get_values() const override
+	{
+		return values;
+	}
+
+	const feature_plane_t*    plane;
+	size_t                    texture = 0;
+	feature_space_t           space;
+	std::vector<blt::color_t> values;
+};
+
+/**
+ * Every per texture statistic the rankings use, computed once when the gpu resources are built or read back from the
+ * texture_features table written by the asset loader. Texture ids are dense indices handed out by gpu_asset_manager. Grids for more than precomputed_samples samples per axis are rarely used and
+ * large, so they are only built the first time a tab asks for them. The same goes for kernel metrics of other sizes.
+ */
+class texture_feature_store_t
+{
+public:
+	static constexpr blt::i32 precomputed_samples = 4;
+	static constexpr blt::i32 max_samples         = 8;
+	static constexpr blt::i32 max_kernel_size     = 8;
+	// bump whenever the layout written by compute() or any sampler changes, stored features of another version are ignored
+	static constexpr blt::i32 layout_version = 4;
+
+	// number of floats compute() produces for a single texture
+	static constexpr size_t values_per_texture()
+	{
+		size_t grid_values = 0;
+		for (blt::i32 samples = 1; samples <= precomputed_samples; samples++)
+			grid_values += static_cast<size_t>(samples * samples);
+		return feature_space_count * (grid_values + 2) * 3;
+	}
+
+	/**
+	 * Computes every precomputed feature of a texture as a flat float array. For each feature space this holds the
+	 * difference and kernel values followed by the grids for 1 to precomputed_samples samples per axis.
+	 */
+	static std::vector<float> compute(const image_t& image);
+
+	texture_feature_store_t(): lazy_mutex{std::make_unique<std::mutex>()}
+	{}
+
+	void build(std::vector<const image_t*> textures);
+
+	// recomputes every built feature of a texture after its pixels changed
+	void update(size_t texture);
+
+	[[nodiscard]] const feature_plane_t& grid(feature_space_t space, blt::i32 samples) const;
+
+	// the 1x1 grid, the mean color of every texture. Built with the store and never lazily, so the ui thread can read it
+	// without waiting on a worker that is building some other plane
+	[[nodiscard]] const feature_plane_t& mean(const feature_space_t space) const
+	{
+		return spaces[static_cast<size_t>(space)].grids[0];
+	}
+
+	[[nodiscard]] const feature_plane_t& difference(const feature_space_t space) const
+	{
+		return spaces[static_cast<size_t>(space)].difference;
+	}
+
+	// kernel metric for a box of size pixels around every pixel, only size 1 is precomputed
+	[[nodiscard]] const feature_plane_t& kernel(feature_space_t space, blt::i32 size = 1) const;
+
+	[[nodiscard]] size_t size() const
+	{
+		return images.size();
+	}
+
+private:
+	struct space_features_t
+	{
+		std::array<feature_plane_t, max_samples>     grids;
+		feature_plane_t                              difference;
+		std::array<feature_plane_t, max_kernel_size> kernels;
+	};
+
+	void build_grid(feature_space_t space, blt::i32 samples) const;
+
+	void build_kernel(feature_space_t space, blt::i32 size) const;
+
+	void unpack(size_t texture, const float* values);
+
+	std::vector<const image_t*>                                images;
+	mutable std::array<space_features_t, feature_space_count> spaces;
+	std::unique_ptr<std::mutex>                                lazy_mutex;
+};
+
+#endif //TEXTURE_FEATURES_H
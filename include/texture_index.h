@@ -0,0 +1,117 @@
+#pragma once
+/*
+ *  Copyright (C) 2024  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTURE_INDEX_H
+#define TEXTURE_INDEX_H
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <texture_features.h>
+
+/**
+ * Vantage point tree over texture ids. It only needs a distance between two textures, so it works for any comparator
+ * that is a metric over the feature vectors (the mean sample comparators are, as a mean of weighted euclidean distances).
+ */
+class vp_tree_t
+{
+public:
+	using distance_func_t = std::function<float(size_t, size_t)>;
+	using query_func_t    = std::function<float(size_t)>;
+	using filter_func_t   = std::function<bool(size_t)>;
+
+	struct neighbour_t
+	{
+		size_t id;
+		float  distance;
+	};
+
+	vp_tree_t(size_t count, const distance_func_t& distance);
+
+	/**
+	 * Finds the k textures closest to the query, sorted by distance then id. Textures rejected by the filter are still
+	 * used to prune the search but are never returned. Returns an empty vector if cancelled part way through.
+	 */
+	[[nodiscard]] std::vector<neighbour_t> nearest(size_t                   k,
+												   const query_func_t&      distance,
+												   const filter_func_t&     accept,
+												   const std::atomic_bool&  cancelled) const;
+
+	[[nodiscard]] size_t size() const
+	{
+		return nodes.size();
+	}
+
+private:
+	static constexpr blt::i32 no_child = -1;
+
+	struct node_t
+	{
+		size_t   id;
+		float    radius = 0;
+		blt::i32 inside  = no_child;
+		blt::i32 outside = no_child;
+	};
+
+	blt::i32 build(std::vector<std::pair<size_t, float>>& items, size_t begin, size_t end, const distance_func_t& distance);
+
+	std::vector<node_t> nodes;
+	blt::i32            root = no_child;
+};
+
+// everything the distances inside a tree depend on
+struct texture_index_key_t
+{
+	feature_space_t      space           = feature_space_t::OKLAB;
+	blt::i32             samples         = 1;
+	int                  comparator_mode = 0;
+	std::array<float, 3> factors{};
+
+	bool operator==(const texture_index_key_t&) const = default;
+};
+
+/**
+ * Trees built for the current gpu resources. Building one costs O(n log n) comparisons so they are kept until the
+ * textures change, gpu_asset_manager clears them whenever it re-tints.
+ */
+class texture_index_cache_t
+{
+public:
+	texture_index_cache_t(): mutex{std::make_unique<std::mutex>()}
+	{}
+
+	std::shared_ptr<const vp_tree_t> get(const texture_index_key_t& key, const std::function<std::shared_ptr<const vp_tree_t>()>& build);
+
+	// tree over every texture of a grid plane, using the comparator as the distance
+	std::shared_ptr<const vp_tree_t> get(const texture_index_key_t& key, const feature_plane_t& grid, comparator_interface_t& comparator);
+
+	void clear();
+
+private:
+	static constexpr size_t capacity = 8;
+
+	std::unique_ptr<std::mutex>                                                      mutex;
+	std::vector<std::pair<texture_index_key_t, std::shared_ptr<const vp_tree_t>>> entries;
+};
+
+#endif //TEXTURE_INDEX_H
@@ -0,0 +1,258 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2025  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <asset_extract.h>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace
+{
+	/**
+	 * Tracks where the parser is while the derived extractor picks values out of the event stream. Every scalar is
+	 * handed over together with the container it sits in, anything the extractor does not keep is dropped right away.
+	 */
+	class extractor_t : public nlohmann::json_sax<json>
+	{
+	public:
+		bool null() override
+		{
+			return true;
+		}
+
+		bool boolean(bool) override
+		{
+			return true;
+		}
+
+		bool number_integer(const number_integer_t value) override
+		{
+			on_integer(static_cast<blt::i64>(value));
+			return true;
+		}
+
+		bool number_unsigned(const number_unsigned_t value) override
+		{
+			on_integer(static_cast<blt::i64>(value));
+			return true;
+		}
+
+		bool number_float(const number_float_t value, const string_t&) override
+		{
+			on_integer(static_cast<blt::i64>(value));
+			return true;
+		}
+
+		bool string(string_t& value) override
+		{
+			on_string(value);
+			return true;
+		}
+
+		bool binary(binary_t&) override
+		{
+			return true;
+		}
+
+		bool start_object(std::size_t) override
+		{
+			scopes.push_back(scope_t{true, {}});
+			return true;
+		}
+
+		bool key(string_t& value) override
+		{
+			scopes.back().key = value;
+			return true;
+		}
+
+		bool end_object() override
+		{
+			scopes.pop_back();
+			return true;
+		}
+
+		bool start_array(std::size_t) override
+		{
+			scopes.push_back(scope_t{false, {}});
+			return true;
+		}
+
+		bool end_array() override
+		{
+			scopes.pop_back();
+			return true;
+		}
+
+		bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override
+		{
+			return false;
+		}
+
+		bool parse(const std::string_view contents)
+		{
+			return json::sax_parse(contents.data(), contents.data() + contents.size(), this);
+		}
+
+	protected:
+		virtual void on_string(std::string&)
+		{}
+
+		virtual void on_integer(blt::i64)
+		{}
+
+		// 1 for values of the top level object
+		[[nodiscard]] size_t depth() const
+		{
+			return scopes.size();
+		}
+
+		// key the current value is stored under, nullptr inside an array
+		[[nodiscard]] const std::string* current_key() const
+		{
+			if (scopes.empty() || !scopes.back().object)
+				return nullptr;
+			return &scopes.back().key;
+		}
+
+		// key the current container is stored under in its parent
+		[[nodiscard]] const std::string* container_key() const
+		{
+			if (scopes.size() < 2 || !scopes[scopes.size() - 2].object)
+				return nullptr;
+			return &scopes[scopes.size() - 2].key;
+		}
+
+		[[nodiscard]] bool in_object() const
+		{
+			return !scopes.empty() && scopes.back().object;
+		}
+
+	private:
+		struct scope_t
+		{
+			bool object;
+			std::string key;
+		};
+
+		std::vector<scope_t> scopes;
+	};
+
+	class model_extractor_t final : public extractor_t
+	{
+	public:
+		model_fields_t fields;
+
+	protected:
+		void on_string(std::string& value) override
+		{
+			if (depth() == 1 && in_object() && *current_key() == "parent")
+				fields.parent = std::move(value);
+			else if (depth() == 2 && container_key() != nullptr && *container_key() == "textures")
+				fields.textures.push_back(std::move(value));
+		}
+	};
+
+	class tag_extractor_t final : public extractor_t
+	{
+	public:
+		bool has_values = false;
+		std::vector<std::string> values;
+
+		bool start_array(const std::size_t size) override
+		{
+			if (depth() == 1 && in_object() && *current_key() == "values")
+				has_values = true;
+			return extractor_t::start_array(size);
+		}
+
+	protected:
+		void on_string(std::string& value) override
+		{
+			if (depth() == 2 && !in_object() && container_key() != nullptr && *container_key() == "values")
+				values.push_back(std::move(value));
+		}
+	};
+
+	class blockstate_extractor_t final : public extractor_t
+	{
+	public:
+		std::vector<std::string> models;
+
+	protected:
+		void on_string(std::string& value) override
+		{
+			if (in_object() && *current_key() == "model")
+				models.push_back(std::move(value));
+		}
+	};
+
+	class biome_extractor_t final : public extractor_t
+	{
+	public:
+		biome_fields_t fields;
+
+	protected:
+		void on_string(std::string& value) override
+		{
+			if (in_object() && !fields.grass_color_modifier && *current_key() == "grass_color_modifier")
+				fields.grass_color_modifier = std::move(value);
+		}
+
+		void on_integer(const blt::i64 value) override
+		{
+			if (!in_object())
+				return;
+			if (!fields.grass_color && *current_key() == "grass_color")
+				fields.grass_color = value;
+			else if (!fields.foliage_color && *current_key() == "foliage_color")
+				fields.foliage_color = value;
+		}
+	};
+}
+
+std::optional<model_fields_t> extract_model(const std::string_view contents)
+{
+	model_extractor_t extractor;
+	if (!extractor.parse(contents))
+		return {};
+	return std::move(extractor.fields);
+}
+
+std::optional<std::vector<std::string>> extract_tag_values(const std::string_view contents)
+{
+	tag_extractor_t extractor;
+	if (!extractor.parse(contents) || !extractor.has_values)
+		return {};
+	return std::move(extractor.values);
+}
+
+std::optional<std::vector<std::string>> extract_blockstate_models(const std::string_view contents)
+{
+	blockstate_extractor_t extractor;
+	if (!extractor.parse(contents))
+		return {};
+	return std::move(extractor.models);
+}
+
+std::optional<biome_fields_t> extract_biome(const std::string_view contents)
+{
+	biome_extractor_t extractor;
+	if (!extractor.parse(contents))
+		return {};
+	return std::move(extractor.fields);
+}
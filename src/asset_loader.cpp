@@ -16,10 +16,20 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <asset_loader.h>
+#include <asset_extract.h>
+#include <texture_features.h>
 
 #include <utility>
+#include <algorithm>
+#include <array>
+#include <condition_variable>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <blt/gfx/stb/stb_image.h>
 #include <nlohmann/json.hpp>
 #include <blt/logging/logging.h>
@@ -29,94 +39,515 @@
 
 using json = nlohmann::json;
 
-inline namespaced_object empty_object{"NULL", "NULL"};
-
-struct search_for_t
+namespace
 {
-	search_for_t(const json& obj, std::string search_tag): search_tag{std::move(search_tag)}
+	// FNV-1a, tells whether a file with a new mtime really changed and which textures have identical pixels
+	blt::i64 hash_contents(const std::string_view contents)
 	{
-		objects.push_back(obj);
+		blt::u64 hash = 14695981039346656037ull;
+		for (const auto c : contents)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ull;
+		}
+		return static_cast<blt::i64>(hash);
 	}
 
-	template <typename T = std::string>
-	std::optional<T> next()
+	// identifies a texture blob by content. Features depend on how the texture is classified, so solid is part of the key
+	struct content_key_t
 	{
-		while (true)
+		blt::i64 hash;
+		blt::i32 width;
+		blt::i32 height;
+		bool     solid;
+
+		bool operator==(const content_key_t&) const = default;
+	};
+
+	struct content_key_hash_t
+	{
+		size_t operator()(const content_key_t& key) const noexcept
 		{
-			if (objects.empty())
-				return {};
-			if (!current_iter)
-				current_iter = objects.front().items().begin();
+			auto hash = static_cast<size_t>(key.hash);
+			hash ^= std::hash<blt::i64>{}(static_cast<blt::i64>(key.width) << 32 | static_cast<blt::u32>(key.height)) + 0x9e3779b97f4a7c15ull +
+				(hash << 6) + (hash >> 2);
+			return hash ^ static_cast<size_t>(key.solid);
+		}
+	};
 
-			while (true)
-			{
-				if (iter() == objects.front().items().end())
-				{
-					objects.erase(objects.begin());
-					current_iter = {};
-					break;
-				}
-				auto value = iter().value();
-				if (value.is_array() || value.is_object())
-				{
-					const auto distance = std::distance(objects.front().items().begin(), iter());
-					objects.push_back(value);
-					current_iter = objects.front().items().begin();
-					std::advance(*current_iter, distance + 1);
-					continue;
-				}
-				if (iter().key() != search_tag)
+	/**
+	 * Content whose features are already taken care of, either stored by an earlier build or being computed by another
+	 * decode worker. Only the first texture with a given content computes features, the rest reuse the blob's.
+	 */
+	class feature_claims_t
+	{
+	public:
+		// true if the caller is the first to ask for this content and has to compute its features
+		bool claim(const content_key_t& key)
+		{
+			std::scoped_lock lock{mutex};
+			return claimed.insert(key).second;
+		}
+
+	private:
+		std::mutex                                             mutex;
+		blt::hashset_t<content_key_t, content_key_hash_t> claimed;
+	};
+
+	struct texture_job_t
+	{
+		std::string namespace_str;
+		std::string       texture;
+		source_location_t location;
+		bool              solid;
+		pixel_format_t    format;
+		// set on the last texture of a namespace, the writer reports the namespace once it gets there
+		size_t namespace_count = 0;
+	};
+
+	struct decoded_texture_t
+	{
+		bool               loaded = false;
+		blt::i32           width  = 0;
+		blt::i32           height = 0;
+		// what stbi returned in the loader's pixel format, the database stores these untouched
+		std::vector<std::byte> pixels;
+		blt::i64               hash = 0;
+		// empty when another texture with the same pixels has or will have them
+		std::vector<float> features;
+	};
+
+	// features are taken from the encoded pixels so they match what the stored texture expands to
+	std::vector<float> compute_features(const std::vector<std::byte>& pixels, const blt::i32 width, const blt::i32 height,
+										const pixel_format_t format, const bool solid)
+	{
+		image_t image;
+		image.width  = width;
+		image.height = height;
+		image.format = format;
+		image.pixels = pixels;
+		prepare_texture_image(image, solid);
+		return texture_feature_store_t::compute(image);
+	}
+
+	decoded_texture_t decode_texture(const texture_job_t& job, feature_claims_t& claims)
+	{
+		decoded_texture_t decoded;
+		if (!job.location.source)
+			return decoded;
+		const auto contents = job.location.source->read(job.location.path);
+		if (!contents)
+			return decoded;
+		int        width, height, channels;
+		const auto ptr = stbi_loadf_from_memory(reinterpret_cast<const unsigned char*>(contents->data()), static_cast<int>(contents->size()),
+												&width, &height, &channels, 4);
+		if (ptr == nullptr)
+			return decoded;
+		decoded.loaded = true;
+		decoded.width  = width;
+		decoded.height = height;
+		decoded.pixels = encode_pixels(job.format, ptr, static_cast<size_t>(width) * static_cast<size_t>(height));
+		stbi_image_free(ptr);
+
+		decoded.hash = hash_contents({reinterpret_cast<const char*>(decoded.pixels.data()), decoded.pixels.size()});
+		if (claims.claim(content_key_t{decoded.hash, width, height, job.solid}))
+			decoded.features = compute_features(decoded.pixels, width, height, job.format, job.solid);
+		return decoded;
+	}
+
+	/**
+	 * Decodes the textures on a pool of workers while the calling thread writes them out strictly in job order, so the
+	 * database ends up identical to decoding them one at a time. Workers stop taking jobs once max_pending decoded
+	 * textures are waiting on the writer.
+	 */
+	void decode_in_order(const std::vector<texture_job_t>& jobs, feature_claims_t& claims,
+						const std::function<void(const texture_job_t&, const decoded_texture_t&)>& write)
+	{
+#ifdef __EMSCRIPTEN__
+		for (const auto& job : jobs)
+			write(job, decode_texture(job, claims));
+#else
+		const size_t                                  thread_count = std::max(1u, std::thread::hardware_concurrency());
+		const size_t                                  max_pending  = thread_count * 4;
+		std::vector<std::optional<decoded_texture_t>> decoded(jobs.size());
+		std::mutex                                    mutex;
+		std::condition_variable                       produced;
+		std::condition_variable                       consumed;
+		size_t                                        next_job = 0;
+		size_t                                        written  = 0;
+
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < thread_count; t++)
+		{
+			workers.emplace_back([&]() {
+				while (true)
 				{
-					++*current_iter;
-					continue;
+					size_t job;
+					{
+						std::unique_lock lock{mutex};
+						consumed.wait(lock, [&]() {
+							return next_job == jobs.size() || next_job < written + max_pending;
+						});
+						if (next_job == jobs.size())
+							return;
+						job = next_job++;
+					}
+					auto result = decode_texture(jobs[job], claims);
+					{
+						std::scoped_lock lock{mutex};
+						decoded[job] = std::move(result);
+					}
+					produced.notify_all();
 				}
-				auto str = iter().value().get<T>();
-				++*current_iter;
-				return str;
+			});
+		}
+
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			decoded_texture_t result;
+			{
+				std::unique_lock lock{mutex};
+				produced.wait(lock, [&]() {
+					return decoded[i].has_value();
+				});
+				result = std::move(*decoded[i]);
+				decoded[i].reset();
+			}
+			write(jobs[i], result);
+			{
+				std::scoped_lock lock{mutex};
+				++written;
 			}
+			consumed.notify_all();
+		}
+
+		for (auto& worker : workers)
+			worker.join();
+#endif
+	}
+
+	void load_manifest(const database_t& db, asset_data_t& data)
+	{
+		auto manifest_table = db.builder().create_table("manifest");
+		manifest_table.with_column<std::string>("path").primary_key();
+		manifest_table.with_column<std::string>("namespace").not_null();
+		manifest_table.with_column<std::string>("kind").not_null();
+		manifest_table.with_column<std::string>("name").not_null();
+		manifest_table.with_column<blt::i64>("size").not_null();
+		manifest_table.with_column<blt::i64>("mtime").not_null();
+		manifest_table.with_column<blt::i64>("hash").not_null();
+		manifest_table.with_column<std::string>("extracted").not_null();
+		manifest_table.build().execute();
+
+		const auto stmt = db.prepare("SELECT path, namespace, kind, name, size, mtime, hash, extracted FROM manifest");
+		while (stmt.execute().has_row())
+		{
+			auto [path, namespace_str, kind, key, size, mtime, hash, extracted] = stmt.fetch().get<
+				std::string, std::string, std::string, std::string, blt::i64, blt::i64, blt::i64, std::string>();
+			data.manifest[path] = manifest_entry_t{namespace_str, kind, key, size, mtime, hash, extracted};
 		}
+		data.manifest_loaded = true;
+		BLT_DEBUG("Manifest lists {} source files", data.manifest.size());
 	}
 
-private:
-	nlohmann::detail::iteration_proxy_value<json::iterator>& iter()
+	// bumped whenever a table changes in a way CREATE TABLE IF NOT EXISTS can't pick up, stored in the user_version pragma
+	constexpr blt::i32 schema_version = 1;
+
+	// narrow tables that are only ever looked up by their composite key, older databases still have them with a rowid
+	constexpr std::array keyed_tables{"solid_textures", "non_solid_textures", "models", "tags", "block_names"};
+
+	/**
+	 * Creates every table load_textures writes, bringing the tables of a database from an older build up to date first.
+	 * Rows that are still valid under the new layout are carried over so nothing has to be decoded again.
+	 */
+	void create_schema(const database_t& db)
 	{
-		return *current_iter;
+		const auto version = std::stoi(db.get_pragma("user_version").value_or("0"));
+
+		// textures used to carry their own pixels, those tables can't hold blob references so everything is decoded again
+		bool legacy_layout = false;
+		{
+			const auto stmt = db.prepare("SELECT 1 FROM pragma_table_info('solid_textures') WHERE name = 'data'");
+			legacy_layout   = stmt.execute().has_row();
+		}
+		if (legacy_layout)
+		{
+			BLT_INFO("[Phase 2] Moving stored textures to shared blobs, every texture is decoded again");
+			db.exec("DROP TABLE solid_textures; DROP TABLE non_solid_textures; DROP TABLE IF EXISTS texture_features");
+		}
+
+		// a table can't lose its rowid in place, the old one is moved aside and copied into the new one once it exists
+		std::vector<std::string> carried;
+		if (version < 1)
+		{
+			const auto stmt = db.prepare("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?");
+			for (const std::string table : keyed_tables)
+			{
+				stmt.bind().bind_all(table);
+				if (stmt.execute().has_row())
+					carried.push_back(table);
+			}
+		}
+		for (const auto& table : carried)
+			db.exec("ALTER TABLE " + table + " RENAME TO " + table + "_upgrade");
+
+		// one row per distinct pixel content, however many namespaces, versions or names share it
+		auto blob_table = db.builder().create_table("texture_blobs");
+		blob_table.with_column<blt::i64>("id").primary_key();
+		blob_table.with_column<blt::i64>("hash").not_null();
+		blob_table.with_column<blt::i32>("width").not_null();
+		blob_table.with_column<blt::i32>("height").not_null();
+		blob_table.with_column<const std::byte*>("data").not_null();
+		blob_table.build().execute();
+
+		auto texture_table = db.builder().create_table("solid_textures");
+		texture_table.with_column<std::string>("namespace").primary_key();
+		texture_table.with_column<std::string>("name").primary_key();
+		texture_table.with_column<blt::i32>("width").not_null();
+		texture_table.with_column<blt::i32>("height").not_null();
+		texture_table.with_column<blt::i64>("blob").not_null();
+		texture_table.without_rowid().build().execute();
+
+		auto non_texture_table = db.builder().create_table("non_solid_textures");
+		non_texture_table.with_column<std::string>("namespace").primary_key();
+		non_texture_table.with_column<std::string>("name").primary_key();
+		non_texture_table.with_column<blt::i32>("width").not_null();
+		non_texture_table.with_column<blt::i32>("height").not_null();
+		non_texture_table.with_column<blt::i64>("blob").not_null();
+		non_texture_table.without_rowid().build().execute();
+
+		// rows are a few kilobytes of floats, too wide to live in the key's b-tree
+		auto features_table = db.builder().create_table("blob_features");
+		features_table.with_column<blt::i64>("blob").primary_key();
+		features_table.with_column<bool>("solid").primary_key();
+		features_table.with_column<blt::i32>("version").not_null();
+		features_table.with_column<const std::byte*>("data").not_null();
+		features_table.build().execute();
+
+		auto model_table = db.builder().create_table("models");
+		model_table.with_column<std::string>("namespace").primary_key();
+		model_table.with_column<std::string>("model").primary_key();
+		model_table.with_column<std::string>("texture_namespace").primary_key();
+		model_table.with_column<std::string>("texture").primary_key();
+		model_table.without_rowid().build().execute();
+
+		auto tag_table = db.builder().create_table("tags");
+		tag_table.with_column<std::string>("namespace").primary_key();
+		tag_table.with_column<std::string>("tag").primary_key();
+		tag_table.with_column<std::string>("block").primary_key();
+		tag_table.without_rowid().build().execute();
+
+		auto tag_models = db.builder().create_table("block_names");
+		tag_models.with_column<std::string>("namespace").primary_key();
+		tag_models.with_column<std::string>("block_name").primary_key();
+		tag_models.with_column<std::string>("model_namespace").primary_key();
+		tag_models.with_column<std::string>("model").primary_key();
+		tag_models.without_rowid().build().execute();
+
+		for (const auto& table : carried)
+			db.exec("INSERT OR IGNORE INTO " + table + " SELECT * FROM " + table + "_upgrade; DROP TABLE " + table + "_upgrade");
+
+		// the joins from textures to blocks go through models and block_names backwards. Entries of an index on a table
+		// without rowid carry the whole primary key, so these cover every column the joins read
+		db.exec("CREATE INDEX IF NOT EXISTS texture_blobs_content ON texture_blobs (hash, width, height); "
+			"CREATE INDEX IF NOT EXISTS models_by_texture ON models (texture_namespace, texture); "
+			"CREATE INDEX IF NOT EXISTS block_names_by_model ON block_names (model_namespace, model)");
+
+		if (version < schema_version)
+			db.exec("PRAGMA user_version = " + std::to_string(schema_version));
 	}
 
-	std::vector<json> objects;
-	std::optional<nlohmann::detail::iteration_proxy_value<json::iterator>> current_iter;
-	std::string search_tag;
-};
+	string_set_t& changed_keys(namespace_data_t& data, const std::string& kind)
+	{
+		if (kind == "model")
+			return data.changed_models;
+		if (kind == "texture")
+			return data.changed_textures;
+		if (kind == "tag")
+			return data.changed_tags;
+		if (kind == "blockstate")
+			return data.changed_block_states;
+		return data.changed_biomes;
+	}
 
-asset_loader_t::asset_loader_t(std::string name): db{name + ".assets"}, name{std::move(name)}
+	/**
+	 * Compares a source file against the manifest. Matching size and mtime are trusted, otherwise the file is hashed so a
+	 * touched but identical file still counts as unchanged. Returns the contents if the file changed and has to be parsed
+	 * again, otherwise the extraction stored in its manifest entry is still good.
+	 */
+	std::optional<std::string> check_source(asset_data_t& data, string_set_t& seen, const asset_source_t& source,
+											const source_file_t& file, string_map_t<std::string>& prefetched,
+											const std::string& namespace_str, const std::string& kind, const std::string& key)
+	{
+		auto path = source.describe(file.path);
+		seen.insert(path);
+		const auto size = file.size;
+		const auto mtime = file.mtime;
+		const auto found = data.manifest.find(path);
+		const bool known = found != data.manifest.end() && found->second.namespace_str == namespace_str && found->second.kind == kind && found
+			->second.key == key;
+		if (known && found->second.size == size && found->second.mtime == mtime)
+			return {};
+
+		std::string contents;
+		if (const auto fetched = prefetched.find(file.path); fetched != prefetched.end())
+			contents = std::move(fetched->second);
+		else
+			contents = source.read(file.path).value_or("");
+		const auto hash = hash_contents(contents);
+		data.manifest_dirty.insert(path);
+		if (known && found->second.hash == hash)
+		{
+			found->second.size = size;
+			found->second.mtime = mtime;
+			return {};
+		}
+		data.manifest[path] = manifest_entry_t{namespace_str, kind, key, size, mtime, hash, ""};
+		changed_keys(data.json_data[namespace_str], kind).insert(key);
+		return contents;
+	}
+
+	struct gathered_sources_t
+	{
+		std::vector<const source_file_t*> files;
+		// contents of the files the manifest cannot vouch for, read up front on every core
+		string_map_t<std::string> contents;
+	};
+
+	gathered_sources_t gather_sources(const asset_data_t& data, const asset_source_t& source, const std::filesystem::path& folder,
+									  const std::vector<std::string>& extensions)
+	{
+		gathered_sources_t gathered;
+		std::vector<const source_file_t*> unknown;
+		for (const auto& file : source.files_in(folder))
+		{
+			const auto extension = std::filesystem::path{file.path}.extension().string();
+			if (std::find(extensions.begin(), extensions.end(), extension) == extensions.end())
+				continue;
+			gathered.files.push_back(&file);
+			const auto found = data.manifest.find(source.describe(file.path));
+			if (found == data.manifest.end() || found->second.size != file.size || found->second.mtime != file.mtime)
+				unknown.push_back(&file);
+		}
+		auto contents = source.read_all(unknown);
+		for (size_t i = 0; i < unknown.size(); i++)
+		{
+			if (contents[i])
+				gathered.contents[unknown[i]->path] = std::move(*contents[i]);
+		}
+		return gathered;
+	}
+
+	// path below the folder with the extension of every part stripped, which is how models, textures and tags are named
+	std::string relative_name(const source_file_t& file, const std::filesystem::path& folder)
+	{
+		std::filesystem::path relative_path;
+		for (const auto& part : std::filesystem::path{file.path}.lexically_relative(folder))
+			relative_path /= part.stem();
+		return relative_path.string();
+	}
+
+	// never remember a file that failed, the next build has to look at it again
+	void forget_source(asset_data_t& data, const std::string& path)
+	{
+		data.manifest.erase(path);
+		data.manifest_dirty.erase(path);
+	}
+
+	// forgets sources of the walked kinds that no longer exist, their keys are marked changed so load_textures drops the rows
+	void sweep_manifest(asset_data_t& data, const string_set_t& seen, const std::string& namespace_str,
+						const std::vector<std::string>& kinds)
+	{
+		for (auto it = data.manifest.begin(); it != data.manifest.end();)
+		{
+			const auto& [path, entry] = *it;
+			if (entry.namespace_str != namespace_str || seen.contains(path) || std::find(kinds.begin(), kinds.end(), entry.kind) == kinds.end())
+			{
+				++it;
+				continue;
+			}
+			changed_keys(data.json_data[namespace_str], entry.kind).insert(entry.key);
+			data.manifest_dirty.erase(path);
+			data.manifest_removed.insert(path);
+			it = data.manifest.erase(it);
+		}
+	}
+
+	namespaced_object object_from_string(const std::string& str)
+	{
+		const auto pos = str.find(':');
+		return namespaced_object{str.substr(0, pos), str.substr(pos + 1)};
+	}
+
+	json model_to_json(const model_data_t& model)
+	{
+		json extracted;
+		extracted["parent"] = model.parent ? json(model.parent->string()) : json(nullptr);
+		extracted["textures"] = json::array();
+		if (model.textures)
+		{
+			for (const auto& texture : *model.textures)
+				extracted["textures"].push_back(texture.string());
+		}
+		return extracted;
+	}
+
+	model_data_t model_from_json(const json& extracted)
+	{
+		model_data_t model;
+		if (!extracted.at("parent").is_null())
+			model.parent = object_from_string(extracted.at("parent").get<std::string>());
+		std::vector<namespaced_object> textures;
+		for (const auto& texture : extracted.at("textures"))
+			textures.push_back(object_from_string(texture.get<std::string>()));
+		if (!textures.empty())
+			model.textures = std::move(textures);
+		return model;
+	}
+}
+
+asset_loader_t::asset_loader_t(std::string name, const pixel_format_t format): db{name + ".assets"}, name{std::move(name)}, format{format}
 {}
 
 std::optional<load_failure_t> asset_loader_t::load_assets(const std::string& asset_folder, const std::optional<std::string>& data_folder)
 {
-	if (!std::filesystem::exists(asset_folder))
+	// stored blobs are told apart by their size alone, a UNORM8 blob would read back as gamma encoded SRGB8
+	if (format == pixel_format_t::UNORM8)
+		return load_failure_t{load_failure_t::UNSUPPORTED_PIXEL_FORMAT, "UNORM8 is a display format, build with SRGB8 instead."};
+
+	const auto assets_source = asset_source_t::open(asset_folder);
+	if (!assets_source)
 		return load_failure_t::ASSET_FOLDER_NOT_FOUND;
 
+	std::shared_ptr<asset_source_t> data_source;
+	if (data_folder)
+	{
+		// packs and client jars hold both halves, only list them once
+		data_source = *data_folder == asset_folder ? assets_source : asset_source_t::open(*data_folder);
+		if (!data_source)
+			return load_failure_t::TAGS_FOLDER_NOT_FOUND;
+	}
+
 	std::optional<std::filesystem::path> model_folder;
 	std::optional<std::filesystem::path> texture_folder;
 	std::optional<std::filesystem::path> tags_folder;
 	std::optional<std::filesystem::path> biomes_folder;
 	std::optional<std::filesystem::path> blockstate_folder;
 
-	for (const auto& entry : std::filesystem::recursive_directory_iterator(asset_folder))
+	for (const auto& directory : assets_source->get_directories())
 	{
-		if (!entry.is_directory())
-			continue;
-		if (entry.path().filename().compare("models") == 0)
+		const std::filesystem::path path{directory};
+		if (path.filename().compare("models") == 0)
 		{
-			model_folder = entry.path();
+			model_folder = path;
 		}
-		if (entry.path().filename().compare("textures") == 0)
+		if (path.filename().compare("textures") == 0)
 		{
-			texture_folder = entry.path();
+			texture_folder = path;
 		}
-		if (data_folder && entry.path().filename().compare("blockstates") == 0)
+		if (data_folder && path.filename().compare("blockstates") == 0)
 		{
-			blockstate_folder = entry.path();
+			blockstate_folder = path;
 		}
 	}
 
@@ -126,23 +557,27 @@ std::optional<load_failure_t> asset_loader_t::load_assets(const std::string& ass
 	if (!texture_folder)
 		return load_failure_t::TEXTURE_FOLDER_NOT_FOUND;
 
-	if (!exists(*model_folder / "block"))
+	if (!assets_source->has_directory(*model_folder / "block"))
 		return load_failure_t::MODEL_FOLDER_NOT_FOUND;
 
-	if (!exists(*texture_folder / "block"))
+	if (!assets_source->has_directory(*texture_folder / "block"))
 		return load_failure_t::TEXTURE_FOLDER_NOT_FOUND;
 
-	const auto namespace_name = model_folder->parent_path().filename();
+	// folders are relative to the source root, which may well be the namespace folder itself
+	const auto describe_folder = [](const asset_source_t& source, const std::filesystem::path& folder) {
+		return std::filesystem::path{source.describe(folder.generic_string())};
+	};
+
+	const auto namespace_name = describe_folder(*assets_source, *model_folder).parent_path().filename();
 
 	if (data_folder)
 	{
-		for (const auto& entry : std::filesystem::recursive_directory_iterator(*data_folder))
+		for (const auto& directory : data_source->get_directories())
 		{
-			if (!entry.is_directory())
-				continue;
-			if (entry.path().filename().compare("tags") == 0)
+			const std::filesystem::path path{directory};
+			if (path.filename().compare("tags") == 0)
 			{
-				tags_folder = entry.path();
+				tags_folder = path;
 				break;
 			}
 		}
@@ -151,7 +586,7 @@ std::optional<load_failure_t> asset_loader_t::load_assets(const std::string& ass
 	if (data_folder && !tags_folder)
 		return load_failure_t::TAGS_FOLDER_NOT_FOUND;
 
-	if (data_folder && !exists(*tags_folder / "block"))
+	if (data_folder && !data_source->has_directory(*tags_folder / "block"))
 		return load_failure_t::TAGS_FOLDER_NOT_FOUND;
 
 	if (data_folder && !blockstate_folder)
@@ -159,112 +594,85 @@ std::optional<load_failure_t> asset_loader_t::load_assets(const std::string& ass
 
 	if (data_folder)
 	{
-		data.json_data[namespace_name.string()].tag_folder = tags_folder->string();
-		data.json_data[namespace_name.string()].data_namespace_folder = tags_folder->parent_path().string();
+		data.json_data[namespace_name.string()].tag_folder = describe_folder(*data_source, *tags_folder).string();
+		data.json_data[namespace_name.string()].data_namespace_folder = describe_folder(*data_source, tags_folder->parent_path()).string();
 
 		biomes_folder = tags_folder->parent_path() / "worldgen" / "biome";
 	}
 
-	data.json_data[namespace_name.string()].asset_namespace_folder = model_folder->parent_path().string();
-	data.json_data[namespace_name.string()].model_folder = model_folder->string();
-	data.json_data[namespace_name.string()].texture_folder = texture_folder->string();
+	data.json_data[namespace_name.string()].asset_namespace_folder = describe_folder(*assets_source, model_folder->parent_path()).string();
+	data.json_data[namespace_name.string()].model_folder = describe_folder(*assets_source, *model_folder).string();
+	data.json_data[namespace_name.string()].texture_folder = describe_folder(*assets_source, *texture_folder).string();
 
 	BLT_INFO("Loading assets '{}' for namespace '{}'", name, namespace_name.string());
-	if (texture_folder->parent_path().filename() != namespace_name)
+	if (describe_folder(*assets_source, *texture_folder).parent_path().filename() != namespace_name)
 		return load_failure_t::INCORRECT_NAMESPACE;
 
-	blt::hashmap_t<std::string, namespace_data_t>& namespaced_models = data.json_data;
+	if (!data.manifest_loaded)
+		load_manifest(db, data);
+	string_set_t seen_sources;
 
-	for (const auto& entry : std::filesystem::recursive_directory_iterator(*model_folder / "block"))
+	string_map_t<namespace_data_t>& namespaced_models = data.json_data;
+
+	auto model_files = gather_sources(data, *assets_source, *model_folder / "block", {".json"});
+	for (const auto* file : model_files.files)
 	{
-		if (!entry.path().has_extension())
-			continue;
-		if (!entry.is_regular_file())
-			continue;
-		if (entry.path().extension().compare(".json") != 0)
+		const auto relative_path = relative_name(*file, *model_folder);
+		const auto source_path = assets_source->describe(file->path);
+
+		const auto contents = check_source(data, seen_sources, *assets_source, *file, model_files.contents, namespace_name.string(), "model",
+										   relative_path);
+		if (!contents)
+		{
+			namespaced_models[namespace_name.string()].models.insert({
+				relative_path, model_from_json(json::parse(data.manifest[source_path].extracted))
+			});
 			continue;
-		std::filesystem::path relative_path;
+		}
+		const auto fields = extract_model(*contents);
+		if (!fields)
 		{
-			auto p_begin = entry.path().begin();
-			auto p_end = entry.path().end();
-			auto m_begin = model_folder->begin();
-			while (p_begin != p_end && m_begin != model_folder->end() && *p_begin == *m_begin)
-			{
-				++p_begin;
-				++m_begin;
-			}
-			for (; p_begin != p_end; ++p_begin)
-				relative_path /= p_begin->stem();
+			BLT_WARN("Skipping model '{}', it is not valid json", source_path);
+			forget_source(data, source_path);
+			continue;
 		}
 
-		std::ifstream file{entry.path()};
-		json data = json::parse(file);
-
 		std::optional<namespaced_object> parent;
 		std::vector<namespaced_object> textures;
 
-		if (data.contains("parent"))
+		if (fields->parent)
 		{
-			const auto lparent = data["parent"].get<std::string>();
-			const auto parts = blt::string::split_sv(lparent, ":");
+			const auto parts = blt::string::split_sv(*fields->parent, ":");
 			if (parts.size() == 1)
 				parent = namespaced_object{namespace_name.string(), std::string{parts[0]}};
 			else
 				parent = namespaced_object{std::string{parts[0]}, std::string{parts[1]}};
 		}
-		if (data.contains("textures"))
+		for (const auto& str : fields->textures)
 		{
-			for (const auto& texture_entry : data["textures"])
-			{
-				auto str = texture_entry.get<std::string>();
-				// not a real texture we care about
-				if (blt::string::starts_with(str, "#"))
-					continue;
-				const auto texture_parts = blt::string::split_sv(str, ":");
-				if (texture_parts.size() == 1)
-					textures.push_back(namespaced_object{namespace_name.string(), std::string{texture_parts[0]}});
-				else
-					textures.push_back(namespaced_object{std::string{texture_parts[0]}, std::string{texture_parts[1]}});
-			}
+			// not a real texture we care about
+			if (blt::string::starts_with(str, "#"))
+				continue;
+			const auto texture_parts = blt::string::split_sv(str, ":");
+			if (texture_parts.size() == 1)
+				textures.push_back(namespaced_object{namespace_name.string(), std::string{texture_parts[0]}});
+			else
+				textures.push_back(namespaced_object{std::string{texture_parts[0]}, std::string{texture_parts[1]}});
 		}
 
-		if (!namespaced_models.contains(namespace_name.string()))
-			namespaced_models[namespace_name.string()] = {};
-		namespaced_models[namespace_name.string()].models.insert({
-			relative_path.string(),
-			model_data_t{parent, textures.empty() ? std::optional<std::vector<namespaced_object>>{} : std::optional{std::move(textures)}}
-		});
+		model_data_t model{parent, textures.empty() ? std::optional<std::vector<namespaced_object>>{} : std::optional{std::move(textures)}};
+		data.manifest[source_path].extracted = model_to_json(model).dump();
+		find_or_emplace(namespaced_models, namespace_name.string()).models.insert({relative_path, std::move(model)});
 	}
 	BLT_INFO("Found {} models in namespace {}", data.json_data[namespace_name.string()].models.size(), namespace_name.string());
 
-	for (const auto& entry : std::filesystem::recursive_directory_iterator(*texture_folder / "block"))
+	auto texture_files = gather_sources(data, *assets_source, *texture_folder / "block", {".png", ".jpg", ".jpeg", ".bmp"});
+	for (const auto* file : texture_files.files)
 	{
-		if (!entry.path().has_extension())
-			continue;
-		if (!entry.is_regular_file())
-			continue;
-		if (entry.path().extension().compare(".png") != 0 && entry.path().extension().compare(".jpg") != 0 && entry.path().extension().
-																													compare(".jpeg") != 0 && entry.
-																																			path().
-																																			extension()
-																																			.compare(
-																																				".bmp")
-			!= 0)
-			continue;
-		std::filesystem::path relative_path;
-		{
-			auto p_begin = entry.path().begin();
-			auto p_end = entry.path().end();
-			auto m_begin = texture_folder->begin();
-			while (p_begin != p_end && m_begin != texture_folder->end() && *p_begin == *m_begin)
-			{
-				++p_begin;
-				++m_begin;
-			}
-			for (; p_begin != p_end; ++p_begin)
-				relative_path /= p_begin->stem();
-		}
-		data.json_data[namespace_name.string()].textures[relative_path.string()] = entry.path().string();
+		const auto relative_path = relative_name(*file, *texture_folder);
+		data.json_data[namespace_name.string()].textures[relative_path] = source_location_t{assets_source, file->path};
+		// only decides whether the texture is decoded again, there is nothing to extract
+		check_source(data, seen_sources, *assets_source, *file, texture_files.contents, namespace_name.string(), "texture", relative_path);
 	}
 	BLT_INFO("Found {} textures in namespace {}", data.json_data[namespace_name.string()].textures.size(), namespace_name.string());
 
@@ -272,63 +680,74 @@ std::optional<load_failure_t> asset_loader_t::load_assets(const std::string& ass
 
 	if (data_folder)
 	{
-		for (const auto& entry : std::filesystem::recursive_directory_iterator{*tags_folder / "block"})
+		auto tag_files = gather_sources(data, *data_source, *tags_folder / "block", {".json"});
+		for (const auto* file : tag_files.files)
 		{
-			if (!entry.path().has_extension())
-				continue;
-			if (!entry.is_regular_file())
-				continue;
-			if (entry.path().extension().compare(".json") != 0)
-				continue;
-			std::filesystem::path relative_path;
+			const auto relative_path = relative_name(*file, *tags_folder);
+			const auto source_path = data_source->describe(file->path);
+			auto& tag_value_list = data.json_data[namespace_name.string()].tags[relative_path].list;
+			const auto contents = check_source(data, seen_sources, *data_source, *file, tag_files.contents, namespace_name.string(), "tag",
+											   relative_path);
+			if (!contents)
 			{
-				auto p_begin = entry.path().begin();
-				auto p_end = entry.path().end();
-				auto m_begin = tags_folder->begin();
-				while (p_begin != p_end && m_begin != tags_folder->end() && *p_begin == *m_begin)
-				{
-					++p_begin;
-					++m_begin;
-				}
-				for (; p_begin != p_end; ++p_begin)
-					relative_path /= p_begin->stem();
+				for (const auto& v : json::parse(data.manifest[source_path].extracted))
+					tag_value_list.insert(v.get<std::string>());
+				continue;
 			}
-			std::ifstream json_file{entry.path()};
-			json jdata = json::parse(json_file);
-			if (!jdata.contains("values"))
-				return load_failure_t{load_failure_t::INCORRECT_TAG_FILE, "Failed at file: " + entry.path().string()};
 
-			auto& tag_value_list = data.json_data[namespace_name.string()].tags[relative_path.string()].list;
+			const auto values = extract_tag_values(*contents);
+			if (!values)
+			{
+				forget_source(data, source_path);
+				return load_failure_t{load_failure_t::INCORRECT_TAG_FILE, "Failed at file: " + source_path};
+			}
 
-			for (const auto& v : jdata["values"])
-				tag_value_list.insert(v.get<std::string>());
+			for (const auto& v : *values)
+				tag_value_list.insert(v);
+			data.manifest[source_path].extracted = json(*values).dump();
 		}
 
 		// blockstate folder consists of only json files
-		for (const auto& entry : std::filesystem::recursive_directory_iterator{*blockstate_folder})
+		auto blockstate_files = gather_sources(data, *assets_source, *blockstate_folder, {".json", ""});
+		for (const auto* file : blockstate_files.files)
 		{
-			if (!entry.is_regular_file())
-				continue;
-			if (entry.path().has_extension() && entry.path().extension().compare(".json") != 0)
-				continue;
-			auto block_name = entry.path().stem().string();
-
-			std::ifstream json_file(entry.path());
-			json jdata = json::parse(json_file);
-
-			search_for_t search{jdata, "model"};
-			while (auto next = search.next())
+			auto block_name = std::filesystem::path{file->path}.stem().string();
+			const auto source_path = assets_source->describe(file->path);
+
+			// model namespace -> models, which is also exactly what the manifest keeps for the file
+			json extracted = json::object();
+			const auto contents = check_source(data, seen_sources, *assets_source, *file, blockstate_files.contents, namespace_name.string(),
+											   "blockstate", block_name);
+			if (contents)
 			{
-				const auto& model = *next;
-				const auto parts = blt::string::split(model, ':');
-				auto namespace_str = namespace_name.string();
-				auto model_str = parts[0];
-				if (parts.size() > 1)
+				const auto models = extract_blockstate_models(*contents);
+				if (!models)
+				{
+					BLT_WARN("Skipping blockstate '{}', it is not valid json", source_path);
+					forget_source(data, source_path);
+					continue;
+				}
+
+				for (const auto& model : *models)
 				{
-					namespace_str = parts[0];
-					model_str = parts[1];
+					const auto parts = blt::string::split(model, ':');
+					auto namespace_str = namespace_name.string();
+					auto model_str = parts[0];
+					if (parts.size() > 1)
+					{
+						namespace_str = parts[0];
+						model_str = parts[1];
+					}
+					extracted[namespace_str].push_back(model_str);
 				}
-				data.json_data[namespace_name.string()].block_states[block_name].models[namespace_str].insert(model_str);
+				data.manifest[source_path].extracted = extracted.dump();
+			} else
+				extracted = json::parse(data.manifest[source_path].extracted);
+
+			for (const auto& [namespace_str, models] : extracted.items())
+			{
+				for (const auto& model : models)
+					data.json_data[namespace_name.string()].block_states[block_name].models[namespace_str].insert(model.get<std::string>());
 			}
 		}
 
@@ -349,58 +768,81 @@ std::optional<load_failure_t> asset_loader_t::load_assets(const std::string& ass
 			}
 		};
 
-		for (const auto& entry : std::filesystem::recursive_directory_iterator{*biomes_folder})
+		auto biome_files = gather_sources(data, *data_source, *biomes_folder, {".json", ""});
+		for (const auto* file : biome_files.files)
 		{
-			if (!entry.is_regular_file())
+			auto biome_name = std::filesystem::path{file->path}.stem().string();
+			const auto source_path = data_source->describe(file->path);
+
+			const auto contents = check_source(data, seen_sources, *data_source, *file, biome_files.contents, namespace_name.string(), "biome",
+											   biome_name);
+			if (!contents)
+			{
+				const auto extracted = json::parse(data.manifest[source_path].extracted);
+				data.json_data[namespace_name.string()].biome_colors[biome_name] = {
+					blt::vec3{extracted[0].get<float>(), extracted[1].get<float>(), extracted[2].get<float>()},
+					blt::vec3{extracted[3].get<float>(), extracted[4].get<float>(), extracted[5].get<float>()}
+				};
 				continue;
-			if (entry.path().has_extension() && entry.path().extension().compare(".json") != 0)
+			}
+			const auto fields = extract_biome(*contents);
+			if (!fields)
+			{
+				BLT_WARN("Skipping biome '{}', it is not valid json", source_path);
+				forget_source(data, source_path);
 				continue;
-			auto biome_name = entry.path().stem().string();
-
-			std::ifstream json_file(entry.path());
-			json jdata = json::parse(json_file);
+			}
 
 			blt::vec3 grass_color{0.48627450980392156, 0.7411764705882353, 0.4196078431372549};
-			search_for_t search_grass{jdata, "grass_color"};
-			if (auto value = search_grass.next<int>())
+			if (fields->grass_color)
 			{
-				grass_color = color::cvtColor(*value);
-			} else
+				grass_color = color::cvtColor(static_cast<int>(*fields->grass_color));
+			} else if (fields->grass_color_modifier)
 			{
-				search_for_t search_grass2{jdata, "grass_color_modifier"};
-				if (auto value = search_grass2.next()) // NOLINT
-				{
-					if (*value == "dark_forest")
-						grass_color = {0.3137254901960784, 0.47843137254901963, 0.19607843137254902};
-					else if (*value == "swamp")
-						grass_color = {0.41568627450980394, 0.4392156862745098, 0.2235294117647059};
-					else
-						BLT_WARN("Unknown grass type {}", *value);
-				}
+				const auto& value = fields->grass_color_modifier;
+				if (*value == "dark_forest")
+					grass_color = {0.3137254901960784, 0.47843137254901963, 0.19607843137254902};
+				else if (*value == "swamp")
+					grass_color = {0.41568627450980394, 0.4392156862745098, 0.2235294117647059};
+				else
+					BLT_WARN("Unknown grass type {}", *value);
 			}
 
 			blt::vec3 foliage_color{0.2823529411764706, 0.7098039215686275, 0.09411764705882353};
-			search_for_t search_leaves{jdata, "foliage_color"};
-
-			if (auto value = search_leaves.next<int>())
-				foliage_color = color::cvtColor(*value);
+			if (fields->foliage_color)
+				foliage_color = color::cvtColor(static_cast<int>(*fields->foliage_color));
 
 			data.json_data[namespace_name.string()].biome_colors[biome_name] = {grass_color, foliage_color};
+			data.manifest[source_path].extracted = json{
+				grass_color[0], grass_color[1], grass_color[2], foliage_color[0], foliage_color[1], foliage_color[2]
+			}.dump();
 		}
 	}
 
+	std::vector<std::string> walked_kinds{"model", "texture"};
+	if (data_folder)
+		walked_kinds.insert(walked_kinds.end(), {"tag", "blockstate", "biome"});
+	sweep_manifest(data, seen_sources, namespace_name.string(), walked_kinds);
+
 	std::vector<namespaced_object> textures_to_load;
 
-	static blt::hashset_t<std::string> solid_parents{
+	const auto intern_all = [](std::initializer_list<std::string_view> names) {
+		blt::hashset_t<asset_id_t> ids;
+		for (const auto name : names)
+			ids.insert(get_symbol_table().intern_full(name));
+		return ids;
+	};
+
+	static const auto solid_parents = intern_all({
 		"minecraft:block/cube_column",
 		"minecraft:block/cube_column_uv_locked_x",
 		"minecraft:block/cube_column_uv_locked_y",
 		"minecraft:block/cube_column_uv_locked_z",
 		"minecraft:block/cube",
 		"minecraft:block/leaves"
-	};
+	});
 
-	static blt::hashset_t<std::string> solid_blocks{
+	static const auto solid_blocks = intern_all({
 		"minecraft:block/honey_block",
 		"minecraft:block/dirt_path",
 		"minecraft:block/dried_kelp_block",
@@ -410,21 +852,15 @@ std::optional<load_failure_t> asset_loader_t::load_assets(const std::string& ass
 		"minecraft:block/brown_mushroom_block",
 		"minecraft:block/mushroom_stem",
 		"minecraft:block/composter"
-	};
+	});
 
+	const auto namespace_string = namespace_name.string();
+	const auto inherits_solid   = data.resolve_solid_parents(map.models, solid_parents);
 	for (auto& [name, model] : map.models)
 	{
-		auto parents = data.resolve_parents(model.parent.value_or(empty_object));
-		bool solid = false;
-		for (const auto& [namespace_str, key_str] : parents)
-		{
-			if (solid_parents.contains(namespace_str + ':' + key_str))
-			{
-				solid = true;
-				break;
-			}
-		}
-		if (solid || solid_blocks.contains(namespace_name.string() + ':' + name))
+		const bool solid = inherits_solid.at(&model);
+		const auto id    = get_symbol_table().find(namespace_string, name);
+		if (solid || (id && solid_blocks.contains(*id)))
 		{
 			if (model.textures)
 			{
@@ -456,61 +892,185 @@ std::optional<load_failure_t> asset_loader_t::load_assets(const std::string& ass
 
 database_t& asset_loader_t::load_textures()
 {
+	BLT_ASSERT(format != pixel_format_t::UNORM8 && "UNORM8 is not a build format, see load_assets()");
 	BLT_INFO("[Phase 2] Loading Textures");
-	auto texture_table = db.builder().create_table("solid_textures");
-	texture_table.with_column<std::string>("namespace").primary_key();
-	texture_table.with_column<std::string>("name").primary_key();
-	texture_table.with_column<blt::i32>("width").not_null();
-	texture_table.with_column<blt::i32>("height").not_null();
-	texture_table.with_column<const std::byte*>("data").not_null();
-	texture_table.build().execute();
-
-	auto non_texture_table = db.builder().create_table("non_solid_textures");
-	non_texture_table.with_column<std::string>("namespace").primary_key();
-	non_texture_table.with_column<std::string>("name").primary_key();
-	non_texture_table.with_column<blt::i32>("width").not_null();
-	non_texture_table.with_column<blt::i32>("height").not_null();
-	non_texture_table.with_column<const std::byte*>("data").not_null();
-	non_texture_table.build().execute();
-
-	const static auto insert_solid_sql = "INSERT INTO solid_textures VALUES (?, ?, ?, ?, ?)";
-	const static auto insert_non_solid_sql = "INSERT INTO non_solid_textures VALUES (?, ?, ?, ?, ?)";
+	bulk_ingest_t ingest{db};
+	ingest.begin_phase("Phase 2 Textures");
+
+	create_schema(db);
+
+	if (!data.manifest_loaded)
+		load_manifest(db, data);
+
+	const static auto insert_solid_sql = "INSERT OR REPLACE INTO solid_textures VALUES (?, ?, ?, ?, ?)";
+	const static auto insert_non_solid_sql = "INSERT OR REPLACE INTO non_solid_textures VALUES (?, ?, ?, ?, ?)";
+	const static auto insert_features_sql = "INSERT OR REPLACE INTO blob_features VALUES (?, ?, ?, ?)";
 	const auto insert_solid_stmt = db.prepare(insert_solid_sql);
 	const auto insert_non_solid_stmt = db.prepare(insert_non_solid_sql);
+	const auto insert_features_stmt = db.prepare(insert_features_sql);
+	const auto insert_blob_stmt = db.prepare("INSERT INTO texture_blobs (hash, width, height, data) VALUES (?, ?, ?, ?)");
+	const auto find_blob_stmt = db.prepare("SELECT id, data FROM texture_blobs WHERE hash = ? AND width = ? AND height = ?");
+	const auto delete_solid_stmt = db.prepare("DELETE FROM solid_textures WHERE namespace = ? AND name = ?");
+	const auto delete_non_solid_stmt = db.prepare("DELETE FROM non_solid_textures WHERE namespace = ? AND name = ?");
+
+	// blobs are left behind here, whatever no texture points at anymore is collected once every texture is written
+	const auto remove_texture = [&](const std::string& namespace_str, const std::string& texture, const bool solid) {
+		const auto& stmt = solid ? delete_solid_stmt : delete_non_solid_stmt;
+		stmt.bind().borrow_all(namespace_str, texture);
+		if (!ingest.execute(stmt))
+			BLT_WARN("Failed to remove texture '{}:{}' from database. Error: '{}'", namespace_str, texture, db.get_error());
+	};
 
-	for (const auto& [namespace_str, textures] : data.solid_textures_to_load)
-	{
-		for (const auto& texture : textures)
-			process_texture(insert_solid_stmt, namespace_str, texture);
-		BLT_INFO("[Phase 2] Loaded {} solid textures for namespace {}", textures.size(), namespace_str);
-	}
+	// namespace -> texture -> whether it is in the pixel format and its features are of the current layout, for what an earlier
+	// build already stored
+	using stored_textures_t = string_map_t<string_map_t<bool>>;
+	const auto load_stored = [&](const std::string& table, const bool solid) {
+		stored_textures_t stored;
+		const auto stmt = db.prepare("SELECT t.namespace, t.name, f.version, t.width, t.height, length(b.data) FROM " + table +
+									" t JOIN texture_blobs b ON b.id = t.blob LEFT JOIN blob_features f ON f.blob = t.blob AND f.solid = ?");
+		stmt.bind().bind_all(solid);
+		while (stmt.execute().has_row())
+		{
+			auto [namespace_str, texture, version, width, height, bytes] = stmt.fetch().get<std::string, std::string, blt::i32, blt::i32,
+				blt::i32, blt::i64>();
+			stored[namespace_str][texture] = version == static_cast<blt::i32>(texture_feature_store_t::layout_version) &&
+				stored_pixel_format(static_cast<size_t>(bytes), width, height) == format;
+		}
+		return stored;
+	};
+	const auto stored_solid = load_stored("solid_textures", true);
+	const auto stored_non_solid = load_stored("non_solid_textures", false);
 
-	for (const auto& [namespace_str, textures] : data.non_solid_textures_to_load)
+	// blob * 2 + solid for every blob that already has features of the current layout
+	blt::hashset_t<blt::i64> featured_blobs;
+	feature_claims_t         claims;
 	{
-		for (const auto& texture : textures)
-			process_texture(insert_non_solid_stmt, namespace_str, texture);
-		BLT_INFO("[Phase 2] Loaded {} non-solid textures for namespace {}", textures.size(), namespace_str);
+		const auto stmt = db.prepare("SELECT b.id, b.hash, b.width, b.height, f.solid FROM blob_features f JOIN texture_blobs b ON b.id = f.blob "
+			"WHERE f.version = ?");
+		stmt.bind().bind_all(texture_feature_store_t::layout_version);
+		while (stmt.execute().has_row())
+		{
+			auto [blob, hash, width, height, solid] = stmt.fetch().get<blt::i64, blt::i64, blt::i32, blt::i32, bool>();
+			featured_blobs.insert(blob * 2 + solid);
+			claims.claim(content_key_t{hash, width, height, solid});
+		}
 	}
 
-	auto model_table = db.builder().create_table("models");
-	model_table.with_column<std::string>("namespace").primary_key();
-	model_table.with_column<std::string>("model").primary_key();
-	model_table.with_column<std::string>("texture_namespace").primary_key();
-	model_table.with_column<std::string>("texture").primary_key();
-	model_table.build().execute();
+	// textures that are gone or changed classification, a reclassified texture is decoded again under its new table
+	const auto remove_stale = [&](const stored_textures_t& stored, const string_map_t<string_set_t>& to_load,
+								const bool solid) {
+		for (const auto& [namespace_str, textures] : stored)
+		{
+			const auto loading = to_load.find(namespace_str);
+			for (const auto& [texture, _] : textures)
+			{
+				if (loading == to_load.end() || !loading->second.contains(texture))
+					remove_texture(namespace_str, texture, solid);
+			}
+		}
+	};
+	remove_stale(stored_solid, data.solid_textures_to_load, true);
+	remove_stale(stored_non_solid, data.non_solid_textures_to_load, false);
+
+	const auto is_current = [&](const stored_textures_t& stored, const std::string& namespace_str, const std::string& texture) {
+		const auto stored_namespace = stored.find(namespace_str);
+		if (stored_namespace == stored.end())
+			return false;
+		const auto stored_texture = stored_namespace->second.find(texture);
+		if (stored_texture == stored_namespace->second.end() || !stored_texture->second)
+			return false;
+		const auto source_namespace = data.json_data.find(namespace_str);
+		return source_namespace == data.json_data.end() || !source_namespace->second.changed_textures.contains(texture);
+	};
+
+	// paths are looked up here, the lookup can insert into json_data which the decode workers must never see change
+	std::vector<texture_job_t> jobs;
+	const auto                 add_jobs = [&](const string_map_t<string_set_t>& to_load,
+											  const stored_textures_t& stored, const bool solid) {
+		for (const auto& [namespace_str, textures] : to_load)
+		{
+			size_t count = 0;
+			for (const auto& texture : textures)
+			{
+				if (is_current(stored, namespace_str, texture))
+					continue;
+				jobs.push_back(texture_job_t{namespace_str, texture, data.json_data[namespace_str].textures[texture], solid, format});
+				++count;
+			}
+			if (count < textures.size())
+				BLT_INFO("[Phase 2] {} {} textures for namespace {} are unchanged", textures.size() - count, solid ? "solid" : "non-solid",
+						namespace_str);
+			if (count > 0)
+				jobs.back().namespace_count = count;
+			else if (textures.empty())
+				BLT_INFO("[Phase 2] Loaded 0 {} textures for namespace {}", solid ? "solid" : "non-solid", namespace_str);
+		}
+	};
+	add_jobs(data.solid_textures_to_load, stored_solid, true);
+	add_jobs(data.non_solid_textures_to_load, stored_non_solid, false);
+
+	// the hash only narrows the search, a blob is shared only when its bytes really are the same
+	const auto find_or_insert_blob = [&](const texture_job_t& job, const decoded_texture_t& decoded) -> std::optional<blt::i64> {
+		find_blob_stmt.bind().bind_all(decoded.hash, decoded.width, decoded.height);
+		while (find_blob_stmt.execute().has_row())
+		{
+			const auto column = find_blob_stmt.fetch();
+			const auto ptr    = column.get<const std::byte*>(1);
+			if (column.size(1) == decoded.pixels.size() && std::equal(decoded.pixels.begin(), decoded.pixels.end(), ptr))
+				return column.get<blt::i64>(0);
+		}
+		insert_blob_stmt.bind().borrow_all(decoded.hash, decoded.width, decoded.height, blt::span{
+											  reinterpret_cast<const char*>(decoded.pixels.data()),
+											  decoded.pixels.size()
+										  });
+		if (!ingest.execute(insert_blob_stmt))
+		{
+			BLT_WARN("Failed to insert pixels of texture '{}:{}' into database. Error: '{}'", job.namespace_str, job.texture, db.get_error());
+			return {};
+		}
+		return db.last_insert_id();
+	};
 
-	auto tag_table = db.builder().create_table("tags");
-	tag_table.with_column<std::string>("namespace").primary_key();
-	tag_table.with_column<std::string>("tag").primary_key();
-	tag_table.with_column<std::string>("block").primary_key();
-	tag_table.build().execute();
+	size_t shared_textures = 0;
+	decode_in_order(jobs, claims, [&](const texture_job_t& job, const decoded_texture_t& decoded) {
+		// the source is gone or unreadable, nothing an earlier build stored for it is valid anymore
+		if (!decoded.loaded)
+			remove_texture(job.namespace_str, job.texture, job.solid);
+		else if (const auto blob = find_or_insert_blob(job, decoded))
+		{
+			const auto& stmt = job.solid ? insert_solid_stmt : insert_non_solid_stmt;
+			stmt.bind().borrow_all(job.namespace_str, job.texture, decoded.width, decoded.height, *blob);
+			if (!ingest.execute(stmt))
+				BLT_WARN("Failed to insert texture '{}:{}' into database. Error: '{}'", job.namespace_str, job.texture, db.get_error());
 
-	auto tag_models = db.builder().create_table("block_names");
-	tag_models.with_column<std::string>("namespace").primary_key();
-	tag_models.with_column<std::string>("block_name").primary_key();
-	tag_models.with_column<std::string>("model_namespace").primary_key();
-	tag_models.with_column<std::string>("model").primary_key();
-	tag_models.build().execute();
+			if (featured_blobs.insert(*blob * 2 + job.solid).second)
+			{
+				// the worker that claimed this content is further back in the order, or only the hash matched
+				const auto features = decoded.features.empty()
+										? compute_features(decoded.pixels, decoded.width, decoded.height, job.format, job.solid)
+										: decoded.features;
+				insert_features_stmt.bind().borrow_all(*blob, job.solid, texture_feature_store_t::layout_version,
+													   blt::span{
+														   reinterpret_cast<const char*>(features.data()),
+														   features.size() * sizeof(float)
+													   });
+				if (!ingest.execute(insert_features_stmt))
+					BLT_WARN("Failed to insert features of texture '{}:{}' into database. Error: '{}'", job.namespace_str, job.texture,
+							 db.get_error());
+			} else
+				++shared_textures;
+		}
+		if (job.namespace_count > 0)
+			BLT_INFO("[Phase 2] Loaded {} {} textures for namespace {}", job.namespace_count, job.solid ? "solid" : "non-solid",
+					 job.namespace_str);
+	});
+	if (shared_textures > 0)
+		BLT_INFO("[Phase 2] {} textures share their pixels and features with another texture", shared_textures);
+
+	// blobs and features nothing points at anymore
+	db.exec("DELETE FROM blob_features WHERE (solid AND blob NOT IN (SELECT blob FROM solid_textures)) OR "
+		"(NOT solid AND blob NOT IN (SELECT blob FROM non_solid_textures)); "
+		"DELETE FROM texture_blobs WHERE id NOT IN (SELECT blob FROM solid_textures UNION SELECT blob FROM non_solid_textures)");
 
 	const static auto insert_tag_sql = "INSERT INTO tags VALUES (?, ?, ?)";
 	const static auto insert_block_name_sql = "INSERT INTO block_names VALUES (?, ?, ?, ?)";
@@ -518,34 +1078,52 @@ database_t& asset_loader_t::load_textures()
 	const auto insert_tag_stmt = db.prepare(insert_tag_sql);
 	const auto insert_block_name_stmt = db.prepare(insert_block_name_sql);
 	const auto insert_models_stmt = db.prepare(insert_models_sql);
+	const auto delete_tag_stmt = db.prepare("DELETE FROM tags WHERE namespace = ? AND tag = ?");
+	const auto delete_block_name_stmt = db.prepare("DELETE FROM block_names WHERE namespace = ? AND block_name = ?");
+	const auto delete_models_stmt = db.prepare("DELETE FROM models WHERE namespace = ? AND model = ?");
+
+	// rows derived from a changed source are dropped and rebuilt, everything else is left as the last build wrote it
+	const auto remove_rows = [&](const statement_t& stmt, const std::string& namespace_str, const string_set_t& keys) {
+		for (const auto& key : keys)
+		{
+			stmt.bind().borrow_all(namespace_str, key);
+			if (!ingest.execute(stmt))
+				BLT_WARN("Unable to remove rows of {}:{} reason '{}'", namespace_str, key, db.get_error());
+		}
+	};
 
 	BLT_DEBUG("[Phase 2] Begin tag storage");
+	ingest.begin_phase("Phase 2 Tags");
 	size_t tag_list_count = 0;
 	size_t tag_model_count = 0;
 	for (const auto& [namespace_str, jdata] : data.json_data)
 	{
+		remove_rows(delete_tag_stmt, namespace_str, jdata.changed_tags);
+		remove_rows(delete_block_name_stmt, namespace_str, jdata.changed_block_states);
 		for (const auto& [tag_name, tag_data] : jdata.tags)
 		{
-			if (tag_data.list.empty())
+			if (tag_data.list.empty() || !jdata.changed_tags.contains(tag_name))
 				continue;
 			for (const auto& block_tag : tag_data.list)
 			{
 				++tag_list_count;
-				insert_tag_stmt.bind().bind_all(namespace_str, tag_name, block_tag);
-				if (!insert_tag_stmt.execute())
+				insert_tag_stmt.bind().borrow_all(namespace_str, tag_name, block_tag);
+				if (!ingest.execute(insert_tag_stmt))
 					BLT_WARN("[Tag List] Unable to insert {} into {}:{} reason '{}'", block_tag, namespace_str, tag_name, db.get_error());
 			}
 			BLT_DEBUG("[Phase 2] Loaded {} blocks to tag {}:{}", tag_data.list.size(), namespace_str, tag_name);
 		}
 		for (const auto& [block_name, bstate] : jdata.block_states)
 		{
+			if (!jdata.changed_block_states.contains(block_name))
+				continue;
 			for (const auto& [model_namespace, model_list] : bstate.models)
 			{
 				for (const auto& model : model_list)
 				{
 					++tag_model_count;
-					insert_block_name_stmt.bind().bind_all(namespace_str, block_name, model_namespace, model);
-					if (!insert_block_name_stmt.execute())
+					insert_block_name_stmt.bind().borrow_all(namespace_str, block_name, model_namespace, model);
+					if (!ingest.execute(insert_block_name_stmt))
 						BLT_WARN("[Block Names] Unable to insert {}:{} into {}:{} reason '{}'", model_namespace, model, namespace_str, block_name,
 							db.get_error());
 				}
@@ -555,30 +1133,30 @@ database_t& asset_loader_t::load_textures()
 	BLT_INFO("[Phase 2] Loaded {} blocks to tags.", tag_list_count);
 	BLT_INFO("[Phase 2] Loaded {} models to tags.", tag_model_count);
 	BLT_INFO("[Phase 2] Saving models texture data.");
+	ingest.begin_phase("Phase 2 Models");
+	auto& symbols = get_symbol_table();
 	for (const auto& [namespace_str, jdata] : data.json_data)
 	{
+		remove_rows(delete_models_stmt, namespace_str, jdata.changed_models);
 		for (const auto& [model_name, model] : jdata.models)
 		{
-			if (model.textures)
+			if (model.textures && jdata.changed_models.contains(model_name))
 			{
-				blt::hashset_t<std::string> declassed_textures;
+				blt::hashset_t<asset_id_t> declassed_textures;
 				for (const auto& texture : *model.textures)
-					declassed_textures.insert(texture.namespace_str + ':' + texture.key_str);
+					declassed_textures.insert(symbols.intern(texture.namespace_str, texture.key_str));
 
-				for (const auto& texture_str : declassed_textures)
+				for (const auto& [texture_namespace, texture] : declassed_textures)
 				{
-					auto parts = blt::string::split(texture_str, ':');
-					if (parts.size() == 1)
-						insert_models_stmt.bind().bind_all(namespace_str, model_name, namespace_str, parts[0]);
-					else
-						insert_models_stmt.bind().bind_all(namespace_str, model_name, parts[0], parts[1]);
-					if (!insert_models_stmt.execute())
+					insert_models_stmt.bind().borrow_all(namespace_str, model_name, symbols.name(texture_namespace), symbols.name(texture));
+					if (!ingest.execute(insert_models_stmt))
 						BLT_WARN("[Model Data] Unable to insert {}:{} into textures. Reason '{}'", namespace_str, model_name, db.get_error());
 				}
 			}
 		}
 	}
 	BLT_INFO("[Phase 2] Saving biome data");
+	ingest.begin_phase("Phase 2 Biomes");
 
 	auto biome_color_table = db.builder().create_table("biome_color");
 	biome_color_table.with_column<std::string>("namespace").primary_key();
@@ -592,57 +1170,123 @@ database_t& asset_loader_t::load_textures()
 	biome_color_table.build().execute();
 
 	auto insert_all = db.prepare("INSERT INTO biome_color VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+	const auto delete_biome_stmt = db.prepare("DELETE FROM biome_color WHERE namespace = ? AND biome = ?");
 
 	for (const auto& [namespace_str, data] : data.json_data)
 	{
+		remove_rows(delete_biome_stmt, namespace_str, data.changed_biomes);
 		for (const auto& [biome, colors] : data.biome_colors)
 		{
-			insert_all.bind().bind_all(namespace_str, biome, colors.grass_color[0], colors.grass_color[1], colors.grass_color[2],
-										colors.leaves_color[0], colors.leaves_color[1], colors.leaves_color[2]);
-			if (insert_all.execute().has_error())
+			if (!data.changed_biomes.contains(biome))
+				continue;
+			insert_all.bind().borrow_all(namespace_str, biome, colors.grass_color[0], colors.grass_color[1], colors.grass_color[2],
+										  colors.leaves_color[0], colors.leaves_color[1], colors.leaves_color[2]);
+			if (ingest.execute(insert_all).has_error())
 				BLT_WARN("Unable to insert into {}:{} reason '{}'", namespace_str, biome, db.get_error());
 		}
 	}
 
+	// written last so a build that stops part way is redone from the sources it did not finish
+	ingest.begin_phase("Phase 2 Manifest");
+	const auto delete_manifest_stmt = db.prepare("DELETE FROM manifest WHERE path = ?");
+	for (const auto& path : data.manifest_removed)
+	{
+		delete_manifest_stmt.bind().borrow_all(path);
+		if (!ingest.execute(delete_manifest_stmt))
+			BLT_WARN("Unable to remove {} from the manifest reason '{}'", path, db.get_error());
+	}
+	const auto insert_manifest_stmt = db.prepare("INSERT OR REPLACE INTO manifest VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+	for (const auto& path : data.manifest_dirty)
+	{
+		const auto& entry = data.manifest.at(path);
+		insert_manifest_stmt.bind().borrow_all(path, entry.namespace_str, entry.kind, entry.key, entry.size, entry.mtime, entry.hash, entry.extracted);
+		if (!ingest.execute(insert_manifest_stmt))
+			BLT_WARN("Unable to store {} in the manifest reason '{}'", path, db.get_error());
+	}
+	data.manifest_removed.clear();
+	data.manifest_dirty.clear();
+	for (auto& [_, namespace_data] : data.json_data)
+	{
+		namespace_data.changed_models.clear();
+		namespace_data.changed_textures.clear();
+		namespace_data.changed_tags.clear();
+		namespace_data.changed_block_states.clear();
+		namespace_data.changed_biomes.clear();
+	}
+	ingest.finish();
 	BLT_INFO("Finished loading assets");
 
 	return db;
 }
 
-void asset_loader_t::process_texture(const statement_t& stmt, const std::string& namespace_str, const std::string& texture)
+blt::hashmap_t<const model_data_t*, bool> asset_data_t::resolve_solid_parents(const string_map_t<model_data_t>& models,
+																		 const blt::hashset_t<asset_id_t>& solid_parents) const
 {
-	const auto texture_path = data.json_data[namespace_str].textures[texture];
-	if (!std::filesystem::exists(texture_path))
-		return;
-	int width, height, channels;
-	const auto ptr = stbi_loadf(texture_path.c_str(), &width, &height, &channels, 4);
-	if (ptr == nullptr)
-		return;
-	stmt.bind().bind_all(namespace_str, texture, width, height, blt::span{
-							reinterpret_cast<char*>(ptr),
-							static_cast<blt::size_t>(width * height * 4) * sizeof(float)
-						});
-	if (!stmt.execute())
+	enum class chain_t : blt::u8
 	{
-		BLT_WARN("Failed to insert texture '{}:{}' into database. Error: '{}'", namespace_str, texture, db.get_error());
-	}
-	stbi_image_free(ptr);
-}
+		VISITING, SOLID, NOT_SOLID
+	};
 
-std::vector<namespaced_object> asset_data_t::resolve_parents(const namespaced_object& model) const
-{
-	std::vector<namespaced_object> parents;
-	auto current_parent = model;
-	while (json_data.contains(current_parent.namespace_str) && json_data.at(current_parent.namespace_str).models.contains(current_parent.key_str))
-	{
-		const auto& [parent, textures] = json_data.at(current_parent.namespace_str).models.at(current_parent.key_str);
-		parents.push_back(current_parent);
-		if (parent)
-			current_parent = *parent;
-		else
-			break;
-	}
-	return parents;
+	// whether a model or anything above it is a solid parent, every model that is reached gets resolved exactly once
+	blt::hashmap_t<const model_data_t*, chain_t> chains;
+	// models walked so far by the current resolve, along with whether each is a solid parent itself
+	std::vector<std::pair<const model_data_t*, bool>> path;
+
+	const auto find_model = [this](const namespaced_object& object) -> const model_data_t* {
+		const auto found_namespace = json_data.find(object.namespace_str);
+		if (found_namespace == json_data.end())
+			return nullptr;
+		const auto found = found_namespace->second.models.find(object.key_str);
+		return found == found_namespace->second.models.end() ? nullptr : &found->second;
+	};
+
+	const auto resolve = [&](const namespaced_object& start) {
+		path.clear();
+		bool solid_above = false;
+		const namespaced_object* current = &start;
+		while (true)
+		{
+			const auto model = find_model(*current);
+			if (model == nullptr)
+				break;
+			if (const auto known = chains.find(model); known != chains.end())
+			{
+				if (known->second != chain_t::VISITING)
+				{
+					solid_above = known->second == chain_t::SOLID;
+					break;
+				}
+				// every model of a cycle has all the others above it
+				const auto cycle_start = std::find_if(path.begin(), path.end(), [model](const auto& entry) {
+					return entry.first == model;
+				});
+				BLT_WARN("Model {} is part of a parent cycle", current->string());
+				for (auto it = cycle_start; it != path.end(); ++it)
+					solid_above = solid_above || it->second;
+				for (auto it = cycle_start; it != path.end(); ++it)
+					chains[it->first] = solid_above ? chain_t::SOLID : chain_t::NOT_SOLID;
+				path.erase(cycle_start, path.end());
+				break;
+			}
+			chains[model] = chain_t::VISITING;
+			const auto id = get_symbol_table().find(current->namespace_str, current->key_str);
+			path.emplace_back(model, id && solid_parents.contains(*id));
+			if (!model->parent)
+				break;
+			current = &*model->parent;
+		}
+		for (auto it = path.rbegin(); it != path.rend(); ++it)
+		{
+			solid_above = solid_above || it->second;
+			chains[it->first] = solid_above ? chain_t::SOLID : chain_t::NOT_SOLID;
+		}
+		return solid_above;
+	};
+
+	blt::hashmap_t<const model_data_t*, bool> inherits_solid;
+	for (const auto& [name, model] : models)
+		inherits_solid[&model] = model.parent && resolve(*model.parent);
+	return inherits_solid;
 }
 
 std::string block_pretty_name(std::string block_name)
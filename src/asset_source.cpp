@@ -0,0 +1,307 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2025  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <asset_source.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <blt/gfx/stb/stb_image.h>
+#include <blt/logging/logging.h>
+
+namespace
+{
+	constexpr blt::u32 end_of_directory_signature = 0x06054b50;
+	constexpr blt::u32 directory_entry_signature  = 0x02014b50;
+	constexpr blt::u32 local_header_signature     = 0x04034b50;
+	constexpr size_t   end_of_directory_size      = 22;
+	constexpr size_t   directory_entry_size       = 46;
+	constexpr size_t   local_header_size          = 30;
+	constexpr blt::u16 method_stored              = 0;
+	constexpr blt::u16 method_deflate             = 8;
+
+	// zip fields are little endian and unaligned
+	blt::u16 read_u16(const char* data)
+	{
+		const auto bytes = reinterpret_cast<const unsigned char*>(data);
+		return static_cast<blt::u16>(bytes[0] | (bytes[1] << 8));
+	}
+
+	blt::u32 read_u32(const char* data)
+	{
+		const auto bytes = reinterpret_cast<const unsigned char*>(data);
+		return static_cast<blt::u32>(bytes[0]) | (static_cast<blt::u32>(bytes[1]) << 8) | (static_cast<blt::u32>(bytes[2]) << 16) |
+			(static_cast<blt::u32>(bytes[3]) << 24);
+	}
+
+	bool read_at(std::ifstream& file, const blt::u64 offset, char* out, const size_t size)
+	{
+		file.seekg(static_cast<std::streamoff>(offset));
+		file.read(out, static_cast<std::streamsize>(size));
+		return static_cast<size_t>(file.gcount()) == size;
+	}
+}
+
+std::shared_ptr<asset_source_t> asset_source_t::open(const std::filesystem::path& location)
+{
+	if (std::filesystem::is_directory(location))
+		return std::make_shared<directory_source_t>(location);
+	if (!std::filesystem::is_regular_file(location))
+		return nullptr;
+	const auto extension = location.extension();
+	if (extension != ".zip" && extension != ".jar")
+		return nullptr;
+	auto source = std::make_shared<zip_source_t>(location);
+	if (!source->is_valid())
+		return nullptr;
+	return source;
+}
+
+bool asset_source_t::has_directory(const std::filesystem::path& directory) const
+{
+	return std::binary_search(directories.begin(), directories.end(), directory.generic_string());
+}
+
+std::span<const source_file_t> asset_source_t::files_in(const std::filesystem::path& directory) const
+{
+	auto prefix = directory.generic_string();
+	if (!prefix.empty() && prefix.back() != '/')
+		prefix += '/';
+	// sorted by path, so everything below a directory is one contiguous run
+	const auto begin = std::lower_bound(files.begin(), files.end(), prefix, [](const source_file_t& file, const std::string& value) {
+		return file.path < value;
+	});
+	auto end = begin;
+	while (end != files.end() && end->path.compare(0, prefix.size(), prefix) == 0)
+		++end;
+	return std::span{files}.subspan(static_cast<size_t>(begin - files.begin()), static_cast<size_t>(end - begin));
+}
+
+std::vector<std::optional<std::string>> asset_source_t::read_all(const std::vector<const source_file_t*>& wanted) const
+{
+	std::vector<std::optional<std::string>> contents(wanted.size());
+#ifdef __EMSCRIPTEN__
+	for (size_t i = 0; i < wanted.size(); i++)
+		contents[i] = read(wanted[i]->path);
+#else
+	std::atomic<size_t>      next = 0;
+	std::vector<std::thread> workers;
+	const auto               thread_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), wanted.size());
+	for (size_t t = 0; t < thread_count; t++)
+	{
+		workers.emplace_back([&]() {
+			for (size_t i = next++; i < wanted.size(); i = next++)
+				contents[i] = read(wanted[i]->path);
+		});
+	}
+	for (auto& worker : workers)
+		worker.join();
+#endif
+	return contents;
+}
+
+void asset_source_t::finish_listing()
+{
+	std::sort(files.begin(), files.end(), [](const source_file_t& a, const source_file_t& b) {
+		return a.path < b.path;
+	});
+	for (const auto& file : files)
+	{
+		for (auto parent = std::filesystem::path{file.path}.parent_path(); !parent.empty(); parent = parent.parent_path())
+			directories.push_back(parent.generic_string());
+	}
+	std::sort(directories.begin(), directories.end());
+	directories.erase(std::unique(directories.begin(), directories.end()), directories.end());
+}
+
+directory_source_t::directory_source_t(std::filesystem::path root): root{std::move(root)}
+{
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(this->root))
+	{
+		if (entry.is_directory())
+			directories.push_back(entry.path().lexically_relative(this->root).generic_string());
+		if (!entry.is_regular_file())
+			continue;
+		files.push_back(source_file_t{
+			entry.path().lexically_relative(this->root).generic_string(),
+			static_cast<blt::i64>(entry.file_size()),
+			static_cast<blt::i64>(entry.last_write_time().time_since_epoch().count())
+		});
+	}
+	finish_listing();
+}
+
+std::optional<std::string> directory_source_t::read(const std::string& path) const
+{
+	std::ifstream file{root / path, std::ios::binary};
+	if (!file)
+		return {};
+	return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+std::string directory_source_t::describe(const std::string& path) const
+{
+	return (root / path).string();
+}
+
+zip_source_t::zip_source_t(std::filesystem::path archive): archive{std::move(archive)}
+{
+	std::ifstream file{this->archive, std::ios::binary};
+	if (!file)
+	{
+		BLT_WARN("Unable to open archive '{}'", this->archive.string());
+		return;
+	}
+	const auto archive_size = static_cast<blt::u64>(std::filesystem::file_size(this->archive));
+	if (archive_size < end_of_directory_size)
+	{
+		BLT_WARN("'{}' is too small to be a zip archive", this->archive.string());
+		return;
+	}
+
+	// the end of central directory record sits behind an optional comment of up to 64k
+	const auto tail_size = static_cast<size_t>(std::min<blt::u64>(archive_size, end_of_directory_size + 0xFFFF));
+	std::string tail(tail_size, '\0');
+	if (!read_at(file, archive_size - tail_size, tail.data(), tail_size))
+		return;
+	std::optional<size_t> end_record;
+	for (size_t i = tail_size - end_of_directory_size + 1; i-- > 0;)
+	{
+		if (read_u32(tail.data() + i) == end_of_directory_signature)
+		{
+			end_record = i;
+			break;
+		}
+	}
+	if (!end_record)
+	{
+		BLT_WARN("'{}' has no zip central directory", this->archive.string());
+		return;
+	}
+	const auto* record           = tail.data() + *end_record;
+	const auto  entry_count      = read_u16(record + 10);
+	const auto  directory_size   = read_u32(record + 12);
+	const auto  directory_offset = read_u32(record + 16);
+	if (entry_count == 0xFFFF || directory_size == 0xFFFFFFFF || directory_offset == 0xFFFFFFFF)
+	{
+		BLT_WARN("'{}' is a zip64 archive, which is not supported", this->archive.string());
+		return;
+	}
+
+	std::string directory(directory_size, '\0');
+	if (!read_at(file, directory_offset, directory.data(), directory_size))
+	{
+		BLT_WARN("'{}' has a truncated central directory", this->archive.string());
+		return;
+	}
+
+	std::vector<std::pair<source_file_t, entry_t>> listed;
+	listed.reserve(entry_count);
+	for (size_t offset = 0; offset + directory_entry_size <= directory.size();)
+	{
+		const auto* header = directory.data() + offset;
+		if (read_u32(header) != directory_entry_signature)
+			break;
+		const auto flags         = read_u16(header + 8);
+		const auto method        = read_u16(header + 10);
+		const auto dos_time      = read_u16(header + 12);
+		const auto dos_date      = read_u16(header + 14);
+		const auto crc           = read_u32(header + 16);
+		const auto compressed    = read_u32(header + 20);
+		const auto size          = read_u32(header + 24);
+		const auto name_length   = read_u16(header + 28);
+		const auto extra_length  = read_u16(header + 30);
+		const auto comment_size  = read_u16(header + 32);
+		const auto local_offset  = read_u32(header + 42);
+		const auto next          = offset + directory_entry_size + name_length + extra_length + comment_size;
+		if (next > directory.size())
+			break;
+		std::string name{header + directory_entry_size, name_length};
+		offset = next;
+
+		// directories are rebuilt from the file paths, encrypted entries cannot be read anyway
+		if (name.empty() || name.back() == '/' || (flags & 1) != 0)
+			continue;
+		if (method != method_stored && method != method_deflate)
+		{
+			BLT_WARN("Skipping '{}' in '{}', compression method {} is not supported", name, this->archive.string(), method);
+			continue;
+		}
+		const auto mtime = (static_cast<blt::i64>(crc) << 32) | (static_cast<blt::i64>(dos_date) << 16) | dos_time;
+		listed.emplace_back(source_file_t{std::move(name), static_cast<blt::i64>(size), mtime},
+							entry_t{local_offset, compressed, size, method});
+	}
+
+	std::sort(listed.begin(), listed.end(), [](const auto& a, const auto& b) {
+		return a.first.path < b.first.path;
+	});
+	for (auto& [source_file, entry] : listed)
+	{
+		files.push_back(std::move(source_file));
+		entries.push_back(entry);
+	}
+	finish_listing();
+	valid = true;
+	BLT_DEBUG("Opened archive '{}' with {} files", this->archive.string(), files.size());
+}
+
+std::optional<std::string> zip_source_t::read(const std::string& path) const
+{
+	const auto found = std::lower_bound(files.begin(), files.end(), path, [](const source_file_t& file, const std::string& value) {
+		return file.path < value;
+	});
+	if (found == files.end() || found->path != path)
+		return {};
+	const auto& entry = entries[static_cast<size_t>(found - files.begin())];
+
+	// every read opens its own stream so entries can be inflated from any thread
+	std::ifstream file{archive, std::ios::binary};
+	char          header[local_header_size];
+	if (!file || !read_at(file, entry.local_header_offset, header, local_header_size) || read_u32(header) != local_header_signature)
+	{
+		BLT_WARN("Corrupt local header for '{}'", describe(path));
+		return {};
+	}
+	// the local extra field does not have to match the central one
+	const auto data_offset = entry.local_header_offset + local_header_size + read_u16(header + 26) + read_u16(header + 28);
+
+	std::string compressed(entry.compressed_size, '\0');
+	if (!read_at(file, data_offset, compressed.data(), compressed.size()))
+	{
+		BLT_WARN("Truncated data for '{}'", describe(path));
+		return {};
+	}
+	if (entry.method == method_stored)
+		return compressed;
+
+	std::string contents(entry.size, '\0');
+	const auto  inflated = stbi_zlib_decode_noheader_buffer(contents.data(), static_cast<int>(contents.size()), compressed.data(),
+															static_cast<int>(compressed.size()));
+	if (inflated != static_cast<int>(contents.size()))
+	{
+		BLT_WARN("Unable to inflate '{}'", describe(path));
+		return {};
+	}
+	return contents;
+}
+
+std::string zip_source_t::describe(const std::string& path) const
+{
+	// same notation java uses for jar entries
+	return archive.string() + "!/" + path;
+}
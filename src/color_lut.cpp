@@ -0,0 +1,255 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2025  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <color_lut.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <optional>
+#include <ranking.h>
+#include <render.h>
+#include <blt/logging/logging.h>
+#include <blt/std/ranges.h>
+
+extern std::optional<gpu_asset_manager> gpu_resources;
+
+blt::vec3 color_lut_t::point_color(const blt::i32 r, const blt::i32 g, const blt::i32 b)
+{
+	constexpr auto scale = static_cast<float>(resolution - 1);
+	return blt::vec3{static_cast<float>(r) / scale, static_cast<float>(g) / scale, static_cast<float>(b) / scale};
+}
+
+std::vector<blt::u32> color_lut_t::candidates(const blt::vec3& linear_rgb) const
+{
+	std::array<blt::i32, 3> low{};
+	for (blt::i32 i = 0; i < 3; i++)
+	{
+		const auto scaled = std::clamp(linear_rgb[i], 0.0f, 1.0f) * static_cast<float>(resolution - 1);
+		low[i]            = std::min(static_cast<blt::i32>(std::floor(scaled)), resolution - 2);
+	}
+
+	std::vector<blt::u32> found;
+	found.reserve(point_textures * 8);
+	for (blt::i32 corner = 0; corner < 8; corner++)
+	{
+		const auto  r      = low[0] + (corner & 1);
+		const auto  g      = low[1] + ((corner >> 1) & 1);
+		const auto  b      = low[2] + ((corner >> 2) & 1);
+		const auto* values = ids.data() + index(r, g, b);
+		for (size_t i = 0; i < point_textures && values[i] != no_texture; i++)
+			found.push_back(values[i]);
+	}
+	std::sort(found.begin(), found.end());
+	found.erase(std::unique(found.begin(), found.end()), found.end());
+	return found;
+}
+
+namespace
+{
+	struct lut_build_t
+	{
+		color_lut_key_t                         key;
+		color_lut_cache_t::source_func_t        source;
+		std::unique_ptr<comparator_interface_t> comparator;
+		std::shared_ptr<color_lut_t>            lut       = std::make_shared<color_lut_t>();
+		std::atomic<blt::i32>                   remaining = color_lut_t::resolution;
+		std::atomic_bool                        failed    = false;
+		std::string                             config;
+	};
+
+	// luts are stored per .assets file, the config string has to capture everything the ids depend on
+	std::string make_config(const lut_build_t& build)
+	{
+		const auto& key   = build.key;
+		const auto& biome = gpu_resources->get_biome();
+		std::string config;
+		config += std::to_string(static_cast<blt::u32>(key.space)) + ';';
+		config += std::to_string(key.samples) + ';';
+		config += std::to_string(key.comparator_mode) + ';';
+		for (const auto f : key.factors)
+			config += std::to_string(f) + ',';
+		config += key.include_non_solid ? "1;" : "0;";
+		for (const auto f : biome.grass_color)
+			config += std::to_string(f) + ',';
+		for (const auto f : biome.leaves_color)
+			config += std::to_string(f) + ',';
+		config += std::to_string(color_lut_t::resolution) + ';';
+		config += std::to_string(color_lut_t::point_textures) + ';';
+		config += std::to_string(texture_feature_store_t::layout_version) + ';';
+		config += std::to_string(gpu_resources->get_texture_order_hash());
+		return config;
+	}
+
+	bool load_lut(lut_build_t& build)
+	{
+		const auto db = gpu_resources->get_database();
+		if (db == nullptr)
+			return false;
+		auto table = db->builder().create_table("color_luts");
+		table.with_column<std::string>("config").primary_key();
+		table.with_column<const std::byte*>("data").not_null();
+		table.build().execute();
+
+		const auto stmt = db->prepare("SELECT data FROM color_luts WHERE config = ?");
+		stmt.bind().bind_all(build.config);
+		if (!stmt.execute().has_row())
+			return false;
+		const auto column = stmt.fetch();
+		auto&      data   = build.lut->data();
+		if (column.size(0) != data.size() * sizeof(blt::u32))
+			return false;
+		std::memcpy(data.data(), column.get<const std::byte*>(0), column.size(0));
+		return true;
+	}
+
+	void save_lut(const lut_build_t& build)
+	{
+		const auto db = gpu_resources->get_database();
+		if (db == nullptr)
+			return;
+		const auto& data = build.lut->data();
+		const auto  stmt = db->prepare("INSERT OR REPLACE INTO color_luts VALUES (?, ?)");
+		stmt.bind().borrow_all(build.config, blt::span{reinterpret_cast<const char*>(data.data()), data.size() * sizeof(blt::u32)});
+		if (!stmt.execute())
+			BLT_WARN("Unable to store color lut. Reason '{}'", db->get_error());
+	}
+
+	void finish_slice(const std::shared_ptr<lut_build_t>& build)
+	{
+		if (--build->remaining != 0)
+			return;
+		// a newer generation has its own cache, nothing here is worth keeping
+		if (!gpu_resources || gpu_resources->get_generation() != build->key.resource_generation)
+			return;
+		if (build->failed)
+		{
+			gpu_resources->luts.abandon(build->key);
+			return;
+		}
+		save_lut(*build);
+		gpu_resources->luts.publish(build->key, build->lut);
+		BLT_INFO("Built color lookup table ({}^3 points)", color_lut_t::resolution);
+	}
+
+	void build_slice(const std::shared_ptr<lut_build_t>& build, const blt::i32 r, const std::atomic_bool& cancelled)
+	{
+		const auto& key = build->key;
+		if (cancelled || !gpu_resources || gpu_resources->get_generation() != key.resource_generation)
+		{
+			build->failed = true;
+			finish_slice(build);
+			return;
+		}
+
+		const auto  comparator  = build->comparator->clone();
+		const auto& grid        = gpu_resources->features.grid(key.space, key.samples);
+		const auto  index       = gpu_resources->indexes.get(texture_index_key_t{key.space, key.samples, key.comparator_mode, key.factors},
+														 grid, *comparator);
+		const auto  solid_count = gpu_resources->get_solid_count();
+		sampler_feature_t image_sampler{grid, 0, key.space};
+
+		for (blt::i32 g = 0; g < color_lut_t::resolution && !cancelled; g++)
+		{
+			for (blt::i32 b = 0; b < color_lut_t::resolution && !cancelled; b++)
+			{
+				const auto sampler = build->source(color_lut_t::point_color(r, g, b), key.samples);
+				const auto nearest = index->nearest(
+					color_lut_t::point_textures,
+					[&](const size_t id) {
+						image_sampler.set_texture(id);
+						return comparator->compare(*sampler, image_sampler);
+					},
+					[&](const size_t id) {
+						return key.include_non_solid || id < solid_count;
+					},
+					cancelled);
+				auto* point = build->lut->point(r, g, b);
+				for (const auto& [i, neighbour] : blt::enumerate(nearest))
+					point[i] = static_cast<blt::u32>(neighbour.id);
+			}
+		}
+		if (cancelled)
+			build->failed = true;
+		finish_slice(build);
+	}
+}
+
+std::shared_ptr<const color_lut_t> color_lut_cache_t::find(const color_lut_key_t& key, const source_func_t& source,
+														   const comparator_interface_t& comparator)
+{
+	{
+		std::scoped_lock lock{*mutex};
+		for (const auto& entry : entries)
+		{
+			if (entry.key == key)
+				return entry.lut;
+		}
+		if (entries.size() >= capacity)
+			entries.erase(entries.begin());
+		// an empty lut marks the key as being built
+		entries.push_back(entry_t{key, nullptr});
+	}
+
+	auto build        = std::make_shared<lut_build_t>();
+	build->key        = key;
+	build->source     = source;
+	build->comparator = comparator.clone();
+	get_ranking_pool().submit_background([build](const std::atomic_bool& cancelled) {
+		if (cancelled || !gpu_resources || gpu_resources->get_generation() != build->key.resource_generation)
+			return;
+		build->config = make_config(*build);
+		if (load_lut(*build))
+		{
+			gpu_resources->luts.publish(build->key, build->lut);
+			BLT_DEBUG("Loaded color lookup table from disk");
+			return;
+		}
+		// one task per red slice so the build spreads over every worker and rankings can cut in between slices
+		for (blt::i32 r = 0; r < color_lut_t::resolution; r++)
+		{
+			get_ranking_pool().submit_background([build, r](const std::atomic_bool& slice_cancelled) {
+				build_slice(build, r, slice_cancelled);
+			});
+		}
+	});
+	return nullptr;
+}
+
+void color_lut_cache_t::publish(const color_lut_key_t& key, std::shared_ptr<const color_lut_t> lut)
+{
+	std::scoped_lock lock{*mutex};
+	for (auto& entry : entries)
+	{
+		if (entry.key == key)
+			entry.lut = std::move(lut);
+	}
+}
+
+void color_lut_cache_t::abandon(const color_lut_key_t& key)
+{
+	std::scoped_lock lock{*mutex};
+	std::erase_if(entries, [&](const entry_t& entry) {
+		return entry.key == key && entry.lut == nullptr;
+	});
+}
+
+void color_lut_cache_t::clear()
+{
+	std::scoped_lock lock{*mutex};
+	entries.clear();
+}
@@ -17,7 +17,14 @@
  */
 #include <blt/math/log_util.h>
 #include <data_loader.h>
+#include <texture_features.h>
 #include <blt/logging/logging.h>
+#include <algorithm>
+#include <thread>
+#include <tuple>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 using namespace blt::color;
 
@@ -29,62 +36,207 @@ database_t load_database(const std::filesystem::path& path)
 
 blt::vec4 access_image(const image_t& image, const blt::i32 x, const blt::i32 y)
 {
-	return {
-		image.data[(y * image.width + x) * 4 + 0],
-		image.data[(y * image.width + x) * 4 + 1],
-		image.data[(y * image.width + x) * 4 + 2],
-		image.data[(y * image.width + x) * 4 + 3]
+	float      rgba[4];
+	const auto index = static_cast<size_t>(y * image.width + x);
+	expand_pixels(image.format, image.pixels.data() + index * bytes_per_pixel(image.format), 1, rgba);
+	return {rgba[0], rgba[1], rgba[2], rgba[3]};
+}
+
+namespace
+{
+	// fewer textures than this per reader and opening another connection costs more than it saves
+	constexpr size_t min_reads_per_reader = 256;
+	constexpr size_t max_readers          = 4;
+
+	// where one image's pixels live, the image is already sized to hold them
+	struct pixel_read_t
+	{
+		std::string namespace_str;
+		std::string name;
+		bool        solid;
+		std::string table;
+		blt::i64    row;
+		image_t*    image  = nullptr;
+		bool        failed = false;
 	};
+
+	// streams the pixels straight out of the database pages into each image, one reader is reused for rows of the same table
+	void read_pixels(const database_t& db, const std::span<pixel_read_t> reads)
+	{
+		std::optional<blob_reader_t> reader;
+		std::string_view             reader_table;
+		for (auto& read : reads)
+		{
+			if (!reader || reader_table != read.table || !reader->reopen(read.row))
+			{
+				reader.emplace(db.open_blob(read.table, "data", read.row));
+				reader_table = read.table;
+			}
+			auto& pixels = read.image->pixels;
+			read.failed  = reader->size() != pixels.size() || !reader->read(pixels.data(), pixels.size());
+		}
+	}
+
+	// separate connections each have their own page cache and file handle, so the reads overlap instead of queueing up
+	void read_pixels_parallel(const database_t& db, std::vector<pixel_read_t>& reads)
+	{
+		// neighbouring rows sit on neighbouring pages
+		std::sort(reads.begin(), reads.end(), [](const pixel_read_t& a, const pixel_read_t& b) {
+			return std::tie(a.table, a.row) < std::tie(b.table, b.row);
+		});
+#ifdef __EMSCRIPTEN__
+		read_pixels(db, reads);
+#else
+		const auto file = db.get_file();
+		const auto readers = std::min({max_readers, static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())),
+										reads.size() / min_reads_per_reader});
+		// in memory databases can't be opened a second time
+		if (file.empty() || readers <= 1)
+			return read_pixels(db, reads);
+
+		const auto               per_reader = (reads.size() + readers - 1) / readers;
+		std::vector<std::thread> threads;
+		for (size_t begin = 0; begin < reads.size(); begin += per_reader)
+		{
+			const std::span chunk{reads.data() + begin, std::min(per_reader, reads.size() - begin)};
+			threads.emplace_back([&file, chunk]() {
+				const database_t reader_db{file};
+				read_pixels(reader_db, chunk);
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+#endif
+	}
 }
 
 assets_t data_loader_t::load()
 {
-	constexpr auto SQL  = "SELECT * FROM solid_textures";
-	auto           stmt = db.prepare(SQL);
-
 	assets_t assets{db};
 
-	while (stmt.execute().has_row())
+	// databases from before textures shared blobs keep the pixels in the texture tables themselves
+	bool legacy_layout = false;
 	{
-		auto column = stmt.fetch();
+		const auto stmt = db.prepare("SELECT 1 FROM pragma_table_info('solid_textures') WHERE name = 'data'");
+		legacy_layout   = stmt.execute().has_row();
+	}
 
-		const auto [namespace_str, name, width, height, ptr] = column.get<
-			std::string, std::string, blt::i32, blt::i32, const std::byte*>();
+	// only the sizes are selected, the pixels are read into the images once they all exist
+	std::vector<pixel_read_t> reads;
+	const auto                load_images = [&](const std::string& table, const bool solid) {
+		const auto& stmt = db.cached(legacy_layout
+										? "SELECT namespace, name, width, height, 0, rowid, length(data) FROM " + table
+										: "SELECT t.namespace, t.name, t.width, t.height, t.blob, t.blob, length(b.data) FROM " + table +
+										" t JOIN texture_blobs b ON b.id = t.blob");
+		for (const auto [namespace_str, name, width, height, blob, row, bytes] : stmt.rows<
+				std::string_view, std::string_view, blt::i32, blt::i32, blt::i64, blt::i64, blt::i64>())
+		{
+			// the blob is kept in whatever format the assets were built with, samplers expand it when they need values
+			const auto format = stored_pixel_format(static_cast<size_t>(bytes), width, height);
+			if (!format)
+			{
+				BLT_WARN("Texture {}:{} has {} bytes of pixels, which fits no pixel format for {}x{}", namespace_str, name, bytes, width,
+						height);
+				continue;
+			}
 
-		const auto size_floats = width * height * 4;
+			auto& namespace_assets = find_or_emplace(assets.assets, namespace_str);
+			auto& image            = find_or_emplace(solid ? namespace_assets.images : namespace_assets.non_solid_images, name);
+			image.width            = width;
+			image.height           = height;
+			image.format           = *format;
+			image.blob             = blob;
+			image.pixels.resize(static_cast<size_t>(bytes));
+			reads.push_back({std::string{namespace_str}, std::string{name}, solid, legacy_layout ? table : "texture_blobs", row});
+		}
+	};
+	load_images("solid_textures", true);
+	load_images("non_solid_textures", false);
 
-		auto& namespace_hash = assets.assets[namespace_str].images;
-		auto& image          = namespace_hash[name];
-		image.width          = width;
-		image.height         = height;
-		image.data.resize(size_floats);
-		std::memcpy(image.data.data(), ptr, size_floats * sizeof(float));
+	// the maps are flat and move their values when they rehash, so the images are only addressed once all of them exist
+	for (auto& read : reads)
+	{
+		auto& namespace_assets = assets.assets.find(read.namespace_str)->second;
+		read.image = &(read.solid ? namespace_assets.images : namespace_assets.non_solid_images).find(read.name)->second;
 	}
 
-	stmt = db.prepare("SELECT * FROM non_solid_textures");
-	stmt.bind();
-	while (stmt.execute().has_row())
+	read_pixels_parallel(db, reads);
+	for (const auto& read : reads)
 	{
-		auto column = stmt.fetch();
+		if (!read.failed)
+			continue;
+		BLT_WARN("Failed to read the pixels of {} row {}, the texture is skipped", read.table, read.row);
+		auto& namespace_assets = assets.assets.find(read.namespace_str)->second;
+		(read.solid ? namespace_assets.images : namespace_assets.non_solid_images).erase(read.name);
+	}
 
-		const auto [namespace_str, name, width, height, ptr] = column.get<
-			std::string, std::string, blt::i32, blt::i32, const std::byte*>();
+	const auto fits_layout = [](const size_t bytes) {
+		return bytes / sizeof(float) == texture_feature_store_t::values_per_texture();
+	};
 
-		const auto size_floats = width * height * 4;
+	size_t loaded_features = 0;
+	if (!legacy_layout)
+	{
+		// features are stored once per blob, every texture sharing the pixels gets a copy
+		blt::hashmap_t<blt::i64, std::vector<float>> blob_features;
+		const auto& stmt = db.cached("SELECT blob, solid, data FROM blob_features WHERE version = ?");
+		stmt.bind().bind_all(texture_feature_store_t::layout_version);
+		while (stmt.execute().has_row())
+		{
+			auto column = stmt.fetch();
+
+			const auto [blob, solid, ptr] = column.get<blt::i64, bool, const float*>();
+			if (!fits_layout(column.size(2)))
+				continue;
+			blob_features[blob * 2 + solid].assign(ptr, ptr + column.size(2) / sizeof(float));
+		}
 
-		auto& namespace_hash = assets.assets[namespace_str].non_solid_images;
-		auto& image          = namespace_hash[name];
-		image.width          = width;
-		image.height         = height;
-		image.data.resize(size_floats);
-		std::memcpy(image.data.data(), ptr, size_floats * sizeof(float));
+		for (auto& [namespace_str, namespace_assets] : assets.assets)
+		{
+			for (const bool solid : {true, false})
+			{
+				for (auto& [name, image] : solid ? namespace_assets.images : namespace_assets.non_solid_images)
+				{
+					const auto it = blob_features.find(image.blob * 2 + solid);
+					if (it == blob_features.end())
+						continue;
+					image.features = it->second;
+					++loaded_features;
+				}
+			}
+		}
+	} else
+	{
+		// databases written before features were stored just compute them when the gpu resources are built
+		if (db.prepare("SELECT name FROM sqlite_master WHERE type='table' AND name='texture_features'").execute().has_row())
+		{
+			const auto& stmt = db.cached("SELECT namespace, name, solid, data FROM texture_features WHERE version = ?");
+			stmt.bind().bind_all(texture_feature_store_t::layout_version);
+			while (stmt.execute().has_row())
+			{
+				auto column = stmt.fetch();
+
+				const auto [namespace_str, name, solid, ptr] = column.get<std::string, std::string, bool, const float*>();
+				if (!fits_layout(column.size(3)))
+					continue;
+
+				auto&      namespace_assets = assets.assets[namespace_str];
+				auto&      images           = solid ? namespace_assets.images : namespace_assets.non_solid_images;
+				const auto it               = images.find(name);
+				if (it == images.end())
+					continue;
+				it->second.features.assign(ptr, ptr + column.size(3) / sizeof(float));
+				++loaded_features;
+			}
+		}
 	}
+	BLT_DEBUG("Loaded stored features for {} textures", loaded_features);
 
-	stmt = db.prepare("SELECT * FROM biome_color");
-	stmt.bind();
-	while (stmt.execute().has_row())
+	const auto& biome_stmt = db.cached("SELECT * FROM biome_color");
+	biome_stmt.bind();
+	while (biome_stmt.execute().has_row())
 	{
-		auto       column                                                                          = stmt.fetch();
+		auto       column                                                                          = biome_stmt.fetch();
 		const auto [namespace_str, biome, grass_r, grass_g, grass_b, leaves_r, leaves_g, leaves_b] = column.get<
 			std::string, std::string, float, float, float, float, float, float>();
 
@@ -94,15 +246,12 @@ assets_t data_loader_t::load()
 		assets.assets[namespace_str].biome_colors[biome] = {grass, leaves};
 	}
 
-	blt::hashmap_t<std::string, blt::hashmap_t<std::string, blt::hashset_t<std::string>>> tags;
-	stmt = db.prepare("SELECT namespace,tag,block FROM tags");
-	stmt.bind();
-	while (stmt.execute().has_row())
-	{
-		auto       column                      = stmt.fetch();
-		const auto [namespace_str, tag, block] = column.get<std::string, std::string, std::string>();
-		tags[namespace_str][tag].insert(block);
-	}
+	auto& symbols = get_symbol_table();
+
+	string_map_t<string_map_t<string_set_t>> tags;
+	for (const auto [namespace_str, tag, block] : db.cached("SELECT namespace,tag,block FROM tags").rows<
+			std::string_view, std::string_view, std::string_view>())
+		find_or_emplace(find_or_emplace(tags, namespace_str), tag).emplace(block);
 
 	std::vector<std::tuple<std::string, std::string, std::string>> tag_list;
 	for (const auto& [namespace_str, tag_map] : tags)
@@ -137,430 +286,457 @@ assets_t data_loader_t::load()
 		{
 			const auto parts = blt::string::split(block, ':');
 			if (parts.size() == 1)
-				assets.assets[namespace_str].tags[tag].insert(namespace_str + ":" += parts[0]);
+				assets.assets[namespace_str].tags[tag].insert(symbols.intern(namespace_str, parts[0]));
 			else
-				assets.assets[namespace_str].tags[tag].insert(block);
+				assets.assets[namespace_str].tags[tag].insert(symbols.intern_full(block));
 		}
 	}
 
-	stmt = db.prepare("SELECT DISTINCT b.namespace, b.block_name, t.namespace, t.name "
-		"FROM (SELECT * FROM non_solid_textures UNION SELECT * FROM solid_textures) as t "
+	const auto& blocks_stmt = db.cached("SELECT DISTINCT b.namespace, b.block_name, t.namespace, t.name "
+		"FROM (SELECT namespace, name FROM non_solid_textures UNION SELECT namespace, name FROM solid_textures) as t "
 		"INNER JOIN models as m ON m.texture_namespace = t.namespace AND m.texture = t.name "
 		"INNER JOIN block_names as b ON m.namespace = b.model_namespace AND m.model = b.model");
-	stmt.bind();
-	while (stmt.execute().has_row())
+	for (const auto [namespace_str, block_name, texture_namespace, texture] : blocks_stmt.rows<
+			std::string_view, std::string_view, std::string_view, std::string_view>())
 	{
-		auto       column                                                  = stmt.fetch();
-		const auto [namespace_str, block_name, texture_namespace, texture] = column.get<
-			std::string, std::string, std::string, std::string>();
-		assets.assets[namespace_str].block_to_textures[block_name].insert(texture_namespace + ":" += texture);
+		auto& block_to_textures = find_or_emplace(assets.assets, namespace_str).block_to_textures;
+		find_or_emplace(block_to_textures, block_name).insert(symbols.intern(texture_namespace, texture));
 	}
 
 	return assets;
 }
 
-sampler_oklab_op_t::sampler_oklab_op_t(const image_t& image, const blt::i32 samples)
+namespace
 {
-	const auto x_step = image.width / samples;
-	const auto y_step = image.height / samples;
-	for (blt::i32 y_pos = 0; y_pos < samples; y_pos++)
+	blt::vec3 cell_average(const color_plane_t& plane, const blt::i32 x_pos, const blt::i32 y_pos, const blt::i32 x_step, const blt::i32 y_step)
 	{
-		for (blt::i32 x_pos = 0; x_pos < samples; x_pos++)
+		float     alpha = 0;
+		blt::vec3 average{};
+		for (blt::i32 y = y_step * y_pos; y < std::min(plane.height, y_step * (y_pos + 1)); y++)
 		{
-			float     alpha = 0;
-			blt::vec3 average{};
-			for (blt::i32 y = y_step * y_pos; y < std::min(image.height, y_step * (y_pos + 1)); y++)
+			for (blt::i32 x = x_step * x_pos; x < std::min(plane.width, x_step * (x_pos + 1)); x++)
 			{
-				for (blt::i32 x = x_step * x_pos; x < std::min(image.width, x_step * (x_pos + 1)); x++)
-				{
-					auto value = access_image(image, x, y);
-
-					const auto a = value.a();
-					average += from<linear_rgb_t>(value).as_oklab().to_vec3() * a;
-					alpha += a;
-				}
+				const auto a = plane.get_alpha(x, y);
+				average += plane.get(x, y) * a;
+				alpha += a;
 			}
-			if (alpha != 0)
-				average = average / alpha;
-			averages.emplace_back(oklab_t{average});
 		}
+		if (alpha != 0)
+			average = average / alpha;
+		return average;
 	}
-}
 
-sampler_linear_rgb_op_t::sampler_linear_rgb_op_t(const image_t& image, const blt::i32 samples)
-{
-	const auto x_step = image.width / samples;
-	const auto y_step = image.height / samples;
-	for (blt::i32 x_pos = 0; x_pos < samples; x_pos++)
+	// linear rgb has always walked the grid column by column, the other spaces row by row
+	template <typename Color>
+	std::vector<blt::color_t> average_grid(const color_plane_t& plane, const blt::i32 samples, const bool column_major = false)
 	{
-		for (blt::i32 y_pos = 0; y_pos < samples; y_pos++)
+		std::vector<blt::color_t> averages;
+		const auto                x_step = plane.width / samples;
+		const auto                y_step = plane.height / samples;
+		for (blt::i32 outer = 0; outer < samples; outer++)
 		{
-			float     alpha = 0;
-			blt::vec3 average{};
-			for (blt::i32 y = y_step * y_pos; y < std::min(image.height, y_step * (y_pos + 1)); y++)
+			for (blt::i32 inner = 0; inner < samples; inner++)
 			{
-				for (blt::i32 x = x_step * x_pos; x < std::min(image.width, x_step * (x_pos + 1)); x++)
-				{
-					auto value = access_image(image, x, y);
-
-					const auto a = value.a();
-					average += blt::make_vec3(value) * a;
-					alpha += a;
-				}
+				const auto x_pos = column_major ? outer : inner;
+				const auto y_pos = column_major ? inner : outer;
+				averages.emplace_back(Color{cell_average(plane, x_pos, y_pos, x_step, y_step)});
 			}
-			if (alpha != 0)
-				average = average / alpha;
-			averages.emplace_back(linear_rgb_t{average});
 		}
+		return averages;
 	}
-}
 
-sampler_srgb_op_t::sampler_srgb_op_t(const image_t& image, blt::i32 samples)
-{
-	const auto x_step = image.width / samples;
-	const auto y_step = image.height / samples;
-	for (blt::i32 y_pos = 0; y_pos < samples; y_pos++)
+	blt::vec3 color_difference(const color_plane_t& plane)
 	{
-		for (blt::i32 x_pos = 0; x_pos < samples; x_pos++)
+		const auto average = cell_average(plane, 0, 0, plane.width, plane.height);
+		float      alpha   = 0;
+		blt::vec3  difference;
+		for (blt::i32 y = 0; y < plane.height; y++)
 		{
-			float     alpha = 0;
-			blt::vec3 average{};
-			for (blt::i32 y = y_step * y_pos; y < std::min(image.height, y_step * (y_pos + 1)); y++)
+			for (blt::i32 x = 0; x < plane.width; x++)
 			{
-				for (blt::i32 x = x_step * x_pos; x < std::min(image.width, x_step * (x_pos + 1)); x++)
-				{
-					auto value = access_image(image, x, y);
-
-					const auto a = value.a();
-					average += from<linear_rgb_t>(value).as_srgb().to_vec3() * a;
-					alpha += a;
-				}
+				const auto a    = plane.get_alpha(x, y);
+				const auto diff = average - plane.get(x, y);
+				difference += diff * diff * a;
+				alpha += a;
 			}
-			if (alpha != 0)
-				average = average / alpha;
-			averages.emplace_back(srgb_t{average});
 		}
+		if (alpha != 0)
+			difference = difference.sqrt() / alpha;
+		return difference;
 	}
-}
 
-sampler_hsv_op_t::sampler_hsv_op_t(const image_t& image, const blt::i32 samples)
-{
-	const auto x_step = image.width / samples;
-	const auto y_step = image.height / samples;
-	for (blt::i32 y_pos = 0; y_pos < samples; y_pos++)
+	/**
+	 * Summed area table over a plane padded by size pixels on every side with pixels from the opposite edge, so the
+	 * alpha weighted average of the (2 * size + 1)^2 box around any pixel costs four lookups whatever the kernel size.
+	 */
+	class wrapped_sat_t
 	{
-		for (blt::i32 x_pos = 0; x_pos < samples; x_pos++)
+	public:
+		wrapped_sat_t(const color_plane_t& plane, const blt::i32 size): size{size}, stride{plane.width + 2 * size + 1}
 		{
-			float     alpha = 0;
-			blt::vec3 average{};
-			for (blt::i32 y = y_step * y_pos; y < std::min(image.height, y_step * (y_pos + 1)); y++)
+			if (plane.width <= 0 || plane.height <= 0)
+				return;
+			const auto rows = plane.height + 2 * size + 1;
+			sums.resize(static_cast<size_t>(stride) * rows);
+			for (blt::i32 y = 1; y < rows; y++)
 			{
-				for (blt::i32 x = x_step * x_pos; x < std::min(image.width, x_step * (x_pos + 1)); x++)
+				const auto            py = wrap(y - 1 - size, plane.height);
+				std::array<double, 4> row{};
+				for (blt::i32 x = 1; x < stride; x++)
 				{
-					auto value = access_image(image, x, y);
-
-					const auto a = value.a();
-					average += from<linear_rgb_t>(value).as_hsv().to_vec3() * a;
-					alpha += a;
+					const auto px    = wrap(x - 1 - size, plane.width);
+					const auto a     = plane.get_alpha(px, py);
+					const auto value = plane.get(px, py);
+					for (blt::i32 c = 0; c < 3; c++)
+						row[c] += static_cast<double>(value[c]) * a;
+					row[3] += a;
+					for (blt::i32 c = 0; c < 4; c++)
+						sums[index(x, y)][c] = sums[index(x, y - 1)][c] + row[c];
 				}
 			}
-			if (alpha != 0)
-				average = average / alpha;
-			averages.emplace_back(hsv_t{average});
 		}
-	}
-}
 
-sampler_color_difference_oklab_t::sampler_color_difference_oklab_t(const image_t& image)
-{
-	const sampler_oklab_op_t oklab{image, 1};
-	auto                     average_color = oklab.get_values()[0];
-	float                    alpha         = 0;
-	blt::vec3                color_difference;
-	for (blt::i32 y = 0; y < image.height; y++)
-	{
-		for (blt::i32 x = 0; x < image.width; x++)
+		[[nodiscard]] blt::vec3 average(const blt::i32 x, const blt::i32 y) const
 		{
-			auto value = access_image(image, x, y);
-
-			const auto a    = value.a();
-			auto       diff = average_color.as_oklab().to_vec3() - from<linear_rgb_t>(value).as_oklab().to_vec3();
-			color_difference += diff * diff * a;
-			alpha += a;
+			const auto            extent = 2 * size + 1;
+			std::array<double, 4> box{};
+			for (blt::i32 c = 0; c < 4; c++)
+				box[c] = sums[index(x + extent, y + extent)][c] - sums[index(x, y + extent)][c] - sums[index(x + extent, y)][c] +
+						 sums[index(x, y)][c];
+			return blt::vec3{static_cast<float>(box[0] / box[3]), static_cast<float>(box[1] / box[3]), static_cast<float>(box[2] / box[3])};
 		}
-	}
-	if (alpha != 0)
-		color_difference = color_difference.sqrt() / alpha;
-	color_differences.emplace_back(oklab_t{color_difference});
-}
 
-sampler_kernel_filter_oklab_t::sampler_kernel_filter_oklab_t(const image_t& image)
-{
-	struct kernel
-	{
-		explicit kernel(const blt::i32 size = 2): size(size)
-		{}
+	private:
+		[[nodiscard]] size_t index(const blt::i32 x, const blt::i32 y) const
+		{
+			return static_cast<size_t>(y) * stride + x;
+		}
 
-		[[nodiscard]] blt::vec3 calculate(const image_t& image, const blt::i32 x, const blt::i32 y) const
+		static blt::i32 wrap(const blt::i32 v, const blt::i32 n)
 		{
-			blt::vec3 avg;
-			float     alpha = 0.0f;
-			for (blt::i32 i = -size; i <= size; i++)
-			{
-				for (blt::i32 j = -size; j <= size; j++)
-				{
-					auto px = x + i;
-					auto py = y + i;
-					if (px < 0)
-						px = image.width + px;
-					if (px >= image.width)
-						px = image.width - px;
-					if (py < 0)
-						py = image.height + py;
-					if (py >= image.height)
-						py = image.height - py;
-					auto value = access_image(image, px, py);
-					avg += from<linear_rgb_t>(value).as_oklab().to_vec3() * value.a();
-					alpha += value.a();
-				}
-			}
-			return avg / alpha;
+			const auto m = v % n;
+			return m < 0 ? m + n : m;
 		}
 
-		blt::i32 size;
+		blt::i32                           size;
+		blt::i32                           stride;
+		std::vector<std::array<double, 4>> sums;
 	};
 
-	const sampler_oklab_op_t oklab{image, 1};
-	const auto               average_color = oklab.get_values()[0];
-	blt::vec3                total;
-	for (blt::i32 y = 0; y < image.height; y++)
+	blt::vec3 kernel_difference(const color_plane_t& plane, const blt::i32 size)
 	{
-		for (blt::i32 x = 0; x < image.width; x++)
+		const wrapped_sat_t sat{plane, size};
+		const auto          average = cell_average(plane, 0, 0, plane.width, plane.height);
+		blt::vec3           total;
+		for (blt::i32 y = 0; y < plane.height; y++)
 		{
-			const auto diff = average_color.as_oklab().to_vec3() - kernel{1}.calculate(image, x, y);
-			total += diff * diff;
+			for (blt::i32 x = 0; x < plane.width; x++)
+			{
+				const auto diff = average - sat.average(x, y);
+				total += diff * diff;
+			}
 		}
+		return total.sqrt() / (plane.width * plane.height);
 	}
-	kernel_averages.emplace_back(oklab_t{total.sqrt() / (image.width * image.height)});
 }
 
-sampler_color_difference_rgb_t::sampler_color_difference_rgb_t(const image_t& image)
+sampler_oklab_op_t::sampler_oklab_op_t(const image_t& image, const blt::i32 samples):
+	sampler_oklab_op_t{convert_image(image, feature_space_t::OKLAB), samples}
+{}
+
+sampler_oklab_op_t::sampler_oklab_op_t(const color_plane_t& plane, const blt::i32 samples): averages{average_grid<oklab_t>(plane, samples)}
+{}
+
+sampler_linear_rgb_op_t::sampler_linear_rgb_op_t(const image_t& image, const blt::i32 samples):
+	sampler_linear_rgb_op_t{convert_image(image, feature_space_t::LINEAR_RGB), samples}
+{}
+
+sampler_linear_rgb_op_t::sampler_linear_rgb_op_t(const color_plane_t& plane, const blt::i32 samples):
+	averages{average_grid<linear_rgb_t>(plane, samples, true)}
+{}
+
+sampler_srgb_op_t::sampler_srgb_op_t(const image_t& image, const blt::i32 samples):
+	sampler_srgb_op_t{convert_image(image, feature_space_t::SRGB), samples}
+{}
+
+sampler_srgb_op_t::sampler_srgb_op_t(const color_plane_t& plane, const blt::i32 samples): averages{average_grid<srgb_t>(plane, samples)}
+{}
+
+sampler_hsv_op_t::sampler_hsv_op_t(const image_t& image, const blt::i32 samples):
+	sampler_hsv_op_t{convert_image(image, feature_space_t::HSV), samples}
+{}
+
+sampler_hsv_op_t::sampler_hsv_op_t(const color_plane_t& plane, const blt::i32 samples): averages{average_grid<hsv_t>(plane, samples)}
+{}
+
+sampler_color_difference_oklab_t::sampler_color_difference_oklab_t(const image_t& image):
+	sampler_color_difference_oklab_t{convert_image(image, feature_space_t::OKLAB)}
+{}
+
+sampler_color_difference_oklab_t::sampler_color_difference_oklab_t(const color_plane_t& plane)
 {
-	const sampler_linear_rgb_op_t linear_rgb{image, 1};
-	auto                          average_color = linear_rgb.get_values()[0];
-	float                         alpha         = 0;
-	blt::vec3                     color_difference;
-	for (blt::i32 y = 0; y < image.height; y++)
-	{
-		for (blt::i32 x = 0; x < image.width; x++)
-		{
-			auto value = access_image(image, x, y);
+	color_differences.emplace_back(oklab_t{color_difference(plane)});
+}
 
-			const auto a    = value.a();
-			auto       diff = average_color.as_linear_rgb().to_vec3() - blt::make_vec3(value);
-			color_difference += diff * diff * a;
-			alpha += a;
-		}
-	}
-	if (alpha != 0)
-		color_difference = color_difference.sqrt() / alpha;
-	color_differences.emplace_back(linear_rgb_t{color_difference});
+sampler_kernel_filter_oklab_t::sampler_kernel_filter_oklab_t(const image_t& image, const blt::i32 size):
+	sampler_kernel_filter_oklab_t{convert_image(image, feature_space_t::OKLAB), size}
+{}
+
+sampler_kernel_filter_oklab_t::sampler_kernel_filter_oklab_t(const color_plane_t& plane, const blt::i32 size)
+{
+	kernel_averages.emplace_back(oklab_t{kernel_difference(plane, size)});
 }
 
-sampler_kernel_filter_rgb_t::sampler_kernel_filter_rgb_t(const image_t& image)
+sampler_color_difference_rgb_t::sampler_color_difference_rgb_t(const image_t& image):
+	sampler_color_difference_rgb_t{convert_image(image, feature_space_t::LINEAR_RGB)}
+{}
+
+sampler_color_difference_rgb_t::sampler_color_difference_rgb_t(const color_plane_t& plane)
 {
-	struct kernel
-	{
-		explicit kernel(const blt::i32 size = 2): size(size)
-		{}
+	color_differences.emplace_back(linear_rgb_t{color_difference(plane)});
+}
 
-		[[nodiscard]] blt::vec3 calculate(const image_t& image, const blt::i32 x, const blt::i32 y) const
-		{
-			blt::vec3 avg;
-			float     alpha = 0.0f;
-			for (blt::i32 i = -size; i <= size; i++)
-			{
-				for (blt::i32 j = -size; j <= size; j++)
-				{
-					auto px = x + i;
-					auto py = y + i;
-					if (px < 0)
-						px = image.width + px;
-					if (px >= image.width)
-						px = image.width - px;
-					if (py < 0)
-						py = image.height + py;
-					if (py >= image.height)
-						py = image.height - py;
-					auto value = access_image(image, px, py);
-					avg += blt::make_vec3(value) * value.a();
-					alpha += value.a();
-				}
-			}
-			return avg / alpha;
-		}
+sampler_kernel_filter_rgb_t::sampler_kernel_filter_rgb_t(const image_t& image, const blt::i32 size):
+	sampler_kernel_filter_rgb_t{convert_image(image, feature_space_t::LINEAR_RGB), size}
+{}
+
+sampler_kernel_filter_rgb_t::sampler_kernel_filter_rgb_t(const color_plane_t& plane, const blt::i32 size)
+{
+	kernel_averages.emplace_back(linear_rgb_t{kernel_difference(plane, size)});
+}
+
+sampler_color_difference_srgb_t::sampler_color_difference_srgb_t(const image_t& image):
+	sampler_color_difference_srgb_t{convert_image(image, feature_space_t::SRGB)}
+{}
+
+sampler_color_difference_srgb_t::sampler_color_difference_srgb_t(const color_plane_t& plane)
+{
+	color_differences.emplace_back(srgb_t{color_difference(plane)});
+}
+
+sampler_kernel_filter_srgb_t::sampler_kernel_filter_srgb_t(const image_t& image, const blt::i32 size):
+	sampler_kernel_filter_srgb_t{convert_image(image, feature_space_t::SRGB), size}
+{}
+
+sampler_kernel_filter_srgb_t::sampler_kernel_filter_srgb_t(const color_plane_t& plane, const blt::i32 size)
+{
+	kernel_averages.emplace_back(srgb_t{kernel_difference(plane, size)});
+}
+
+sampler_color_difference_hsv_t::sampler_color_difference_hsv_t(const image_t& image):
+	sampler_color_difference_hsv_t{convert_image(image, feature_space_t::HSV)}
+{}
+
+sampler_color_difference_hsv_t::sampler_color_difference_hsv_t(const color_plane_t& plane)
+{
+	color_differences.emplace_back(hsv_t{color_difference(plane)});
+}
+
+sampler_kernel_filter_hsv_t::sampler_kernel_filter_hsv_t(const image_t& image, const blt::i32 size):
+	sampler_kernel_filter_hsv_t{convert_image(image, feature_space_t::HSV), size}
+{}
 
-		blt::i32 size;
+sampler_kernel_filter_hsv_t::sampler_kernel_filter_hsv_t(const color_plane_t& plane, const blt::i32 size)
+{
+	kernel_averages.emplace_back(hsv_t{kernel_difference(plane, size)});
+}
+
+fused_sampler_t::fused_sampler_t(const color_plane_t& plane, const feature_space_t space, const blt::i32 max_samples,
+								 const blt::i32 kernel_size)
+{
+	struct cell_t
+	{
+		blt::vec3 sum;
+		float     alpha = 0;
 	};
 
-	const sampler_linear_rgb_op_t lin_rgb{image, 1};
-	const auto                    average_color = lin_rgb.get_values()[0];
-	blt::vec3                     total;
-	for (blt::i32 y = 0; y < image.height; y++)
+	// column of every pixel within each grid, -1 where the grid does not cover it
+	std::vector<std::vector<cell_t>>   cells(max_samples);
+	std::vector<std::vector<blt::i32>> columns(max_samples);
+	for (blt::i32 samples = 1; samples <= max_samples; samples++)
 	{
-		for (blt::i32 x = 0; x < image.width; x++)
+		cells[samples - 1].resize(samples * samples);
+		auto&      column = columns[samples - 1];
+		const auto x_step = plane.width / samples;
+		column.resize(plane.width, -1);
+		for (blt::i32 x = 0; x < plane.width && x_step > 0; x++)
 		{
-			const auto diff = average_color.as_linear_rgb().to_vec3() - kernel{1}.calculate(image, x, y);
-			total += diff * diff;
+			if (x / x_step < samples)
+				column[x] = x / x_step;
 		}
 	}
-	kernel_averages.emplace_back(linear_rgb_t{total.sqrt() / (image.width * image.height)});
-}
 
-sampler_color_difference_srgb_t::sampler_color_difference_srgb_t(const image_t& image)
-{
-	const sampler_srgb_op_t srgb{image, 1};
-	auto                    average_color = srgb.get_values()[0];
-	float                   alpha         = 0;
-	blt::vec3               color_difference;
-	for (blt::i32 y = 0; y < image.height; y++)
+	const wrapped_sat_t sat{plane, kernel_size};
+
+	// differences come out of the first two moments, kept in double since they cancel against the average
+	std::array<double, 3> weighted{}, weighted_squares{}, kernel_sum{}, kernel_squares{};
+	for (blt::i32 y = 0; y < plane.height; y++)
 	{
-		for (blt::i32 x = 0; x < image.width; x++)
+		for (blt::i32 samples = 1; samples <= max_samples; samples++)
 		{
-			auto value = access_image(image, x, y);
-
-			const auto a = value.a();
-			auto diff = average_color.as_srgb().to_vec3() - linear_rgb_t{blt::make_vec3(value)}.to_srgb().to_vec3();
-			color_difference += diff * diff * a;
-			alpha += a;
+			const auto y_step = plane.height / samples;
+			if (y_step == 0 || y / y_step >= samples)
+				continue;
+			const auto  row    = y / y_step;
+			const auto& column = columns[samples - 1];
+			auto&       grid   = cells[samples - 1];
+			for (blt::i32 x = 0; x < plane.width; x++)
+			{
+				if (column[x] < 0)
+					continue;
+				const auto a = plane.get_alpha(x, y);
+				auto&      cell = grid[row * samples + column[x]];
+				cell.sum += plane.get(x, y) * a;
+				cell.alpha += a;
+			}
+		}
+		for (blt::i32 x = 0; x < plane.width; x++)
+		{
+			const auto a      = plane.get_alpha(x, y);
+			const auto value  = plane.get(x, y);
+			const auto kernel_value = sat.average(x, y);
+			for (blt::i32 c = 0; c < 3; c++)
+			{
+				weighted[c] += static_cast<double>(value[c]) * a;
+				weighted_squares[c] += static_cast<double>(value[c]) * value[c] * a;
+				kernel_sum[c] += kernel_value[c];
+				kernel_squares[c] += static_cast<double>(kernel_value[c]) * kernel_value[c];
+			}
 		}
 	}
-	if (alpha != 0)
-		color_difference = color_difference.sqrt() / alpha;
-	color_differences.emplace_back(srgb_t{color_difference});
-}
 
-sampler_kernel_filter_srgb_t::sampler_kernel_filter_srgb_t(const image_t& image)
-{
-	struct kernel
+	const bool column_major = space == feature_space_t::LINEAR_RGB;
+	for (blt::i32 samples = 1; samples <= max_samples; samples++)
 	{
-		explicit kernel(const blt::i32 size = 2): size(size)
-		{}
-
-		[[nodiscard]] blt::vec3 calculate(const image_t& image, const blt::i32 x, const blt::i32 y) const
+		auto& grid = grids.emplace_back();
+		for (blt::i32 outer = 0; outer < samples; outer++)
 		{
-			blt::vec3 avg;
-			float     alpha = 0.0f;
-			for (blt::i32 i = -size; i <= size; i++)
+			for (blt::i32 inner = 0; inner < samples; inner++)
 			{
-				for (blt::i32 j = -size; j <= size; j++)
-				{
-					auto px = x + i;
-					auto py = y + i;
-					if (px < 0)
-						px = image.width + px;
-					if (px >= image.width)
-						px = image.width - px;
-					if (py < 0)
-						py = image.height + py;
-					if (py >= image.height)
-						py = image.height - py;
-					auto value = access_image(image, px, py);
-					avg += linear_rgb_t{blt::make_vec3(value)}.to_srgb().to_vec3() * value.a();
-					alpha += value.a();
-				}
+				const auto x_pos = column_major ? outer : inner;
+				const auto y_pos = column_major ? inner : outer;
+				const auto& cell = cells[samples - 1][y_pos * samples + x_pos];
+				grid.push_back(cell.alpha != 0 ? cell.sum / cell.alpha : cell.sum);
 			}
-			return avg / alpha;
 		}
+	}
 
-		blt::i32 size;
-	};
-
-	const sampler_srgb_op_t srgb{image, 1};
-	const auto              average_color = srgb.get_values()[0];
-	blt::vec3               total;
-	for (blt::i32 y = 0; y < image.height; y++)
+	const auto& total = cells.front().front();
+	const auto  count = static_cast<double>(plane.width) * plane.height;
+	for (blt::i32 c = 0; c < 3; c++)
 	{
-		for (blt::i32 x = 0; x < image.width; x++)
+		const double avg = average()[c];
+		if (total.alpha != 0)
 		{
-			const auto diff = average_color.as_srgb().to_vec3() - kernel{1}.calculate(image, x, y);
-			total += diff * diff;
+			const auto spread = avg * avg * total.alpha - 2 * avg * weighted[c] + weighted_squares[c];
+			difference[c]     = static_cast<float>(std::sqrt(std::max(spread, 0.0)) / total.alpha);
 		}
+		const auto spread = avg * avg * count - 2 * avg * kernel_sum[c] + kernel_squares[c];
+		kernel[c]         = static_cast<float>(std::sqrt(std::max(spread, 0.0)) / count);
 	}
-	kernel_averages.emplace_back(srgb_t{total.sqrt() / (image.width * image.height)});
 }
 
-sampler_color_difference_hsv_t::sampler_color_difference_hsv_t(const image_t& image)
+std::shared_ptr<const batch_terms_t::terms_t> batch_terms_t::get(const key_t& key, const std::function<terms_t()>& build)
 {
-	const sampler_hsv_op_t srgb{image, 1};
-	auto                   average_color = srgb.get_values()[0];
-	float                  alpha         = 0;
-	blt::vec3              color_difference;
-	for (blt::i32 y = 0; y < image.height; y++)
+	// building under the lock means workers asking for the same terms wait for one build instead of each doing it
+	std::scoped_lock lock{mutex};
+	const auto       found = std::find_if(entries.begin(), entries.end(), [&key](const auto& entry) {
+		return entry.first == key;
+	});
+	if (found != entries.end())
 	{
-		for (blt::i32 x = 0; x < image.width; x++)
-		{
-			auto value = access_image(image, x, y);
+		std::rotate(entries.begin(), found, found + 1);
+		return entries.front().second;
+	}
+	if (entries.size() == max_entries)
+		entries.pop_back();
+	entries.emplace(entries.begin(), key, std::make_shared<const terms_t>(build()));
+	return entries.front().second;
+}
 
-			const auto a    = value.a();
-			auto       diff = average_color.as_hsv().to_vec3() - linear_rgb_t{blt::make_vec3(value)}.to_hsv().to_vec3();
-			color_difference += diff * diff * a;
-			alpha += a;
-		}
+void batch_terms_t::clear()
+{
+	std::scoped_lock lock{mutex};
+	entries.clear();
+}
+
+sampler_batch_value_t::sampler_batch_value_t(const comparator_batch_t& batch, const size_t candidate): batch{&batch}
+{
+	values.reserve(batch.values_per_candidate);
+	set_candidate(candidate);
+}
+
+void sampler_batch_value_t::set_candidate(const size_t candidate)
+{
+	values.clear();
+	for (blt::i32 i = 0; i < batch->values_per_candidate; i++)
+		values.push_back(make_feature_color(batch->space, batch->get(candidate, i)));
+}
+
+void comparator_interface_t::compare_batch(sampler_interface_t& query, const comparator_batch_t& batch, float* scores)
+{
+	if (batch.count == 0)
+		return;
+	sampler_batch_value_t candidate{batch, 0};
+	for (size_t i = 0; i < batch.count; i++)
+	{
+		candidate.set_candidate(i);
+		scores[i] = compare(query, candidate);
 	}
-	if (alpha != 0)
-		color_difference = color_difference.sqrt() / alpha;
-	color_differences.emplace_back(hsv_t{color_difference});
 }
 
-sampler_kernel_filter_hsv_t::sampler_kernel_filter_hsv_t(const image_t& image)
+namespace
 {
-	struct kernel
+	// sqrtps rounds exactly like std::sqrt, so batch scores match compare() whichever path produced them
+	void sqrt_in_place(float* values, const size_t count)
 	{
-		explicit kernel(const blt::i32 size = 2): size(size)
-		{}
+		size_t i = 0;
+#ifdef __SSE__
+		for (; i + 4 <= count; i += 4)
+			_mm_storeu_ps(values + i, _mm_sqrt_ps(_mm_loadu_ps(values + i)));
+#endif
+		for (; i < count; i++)
+			values[i] = std::sqrt(values[i]);
+	}
 
-		[[nodiscard]] blt::vec3 calculate(const image_t& image, const blt::i32 x, const blt::i32 y) const
-		{
-			blt::vec3 avg;
-			float     alpha = 0.0f;
-			for (blt::i32 i = -size; i <= size; i++)
+	void check_batch(const std::span<const blt::color_t> query, const comparator_batch_t& batch)
+	{
+		BLT_ASSERT(query.size() == static_cast<size_t>(batch.values_per_candidate) && "samplers must provide the same number of elements");
+	}
+
+	// one pass over every value of the batch, derive turns a value into its terms
+	template <typename F>
+	std::shared_ptr<const batch_terms_t::terms_t> get_terms(const comparator_batch_t& batch, const batch_terms_t::key_t& key, const F& derive)
+	{
+		const auto build = [&batch, &derive]() {
+			batch_terms_t::terms_t terms;
+			for (auto& channel : terms)
+				channel.resize(batch.count * batch.values_per_candidate);
+			for (blt::i32 j = 0; j < batch.values_per_candidate; j++)
 			{
-				for (blt::i32 j = -size; j <= size; j++)
+				for (size_t i = 0; i < batch.count; i++)
 				{
-					auto px = x + i;
-					auto py = y + i;
-					if (px < 0)
-						px = image.width + px;
-					if (px >= image.width)
-						px = image.width - px;
-					if (py < 0)
-						py = image.height + py;
-					if (py >= image.height)
-						py = image.height - py;
-					auto value = access_image(image, px, py);
-					avg += linear_rgb_t{blt::make_vec3(value)}.to_hsv().to_vec3() * value.a();
-					alpha += value.a();
+					const blt::vec3 value = derive(batch.get(i, j));
+					for (size_t c = 0; c < 3; c++)
+						terms[c][j * batch.count + i] = value[c];
 				}
 			}
-			return avg / alpha;
-		}
-
-		blt::i32 size;
-	};
+			return terms;
+		};
+		if (batch.terms == nullptr)
+			return std::make_shared<const batch_terms_t::terms_t>(build());
+		return batch.terms->get(key, build);
+	}
 
-	const sampler_hsv_op_t srgb{image, 1};
-	const auto             average_color = srgb.get_values()[0];
-	blt::vec3              total;
-	for (blt::i32 y = 0; y < image.height; y++)
+	// candidate j's terms of every candidate, the way accumulate_distances() wants them
+	std::array<const float*, 3> value_terms(const batch_terms_t::terms_t& terms, const comparator_batch_t& batch, const size_t value,
+											const size_t channels = 3)
 	{
-		for (blt::i32 x = 0; x < image.width; x++)
-		{
-			const auto diff = average_color.as_hsv().to_vec3() - kernel{1}.calculate(image, x, y);
-			total += diff * diff;
-		}
+		std::array<const float*, 3> pointers{};
+		for (size_t c = 0; c < channels; c++)
+			pointers[c] = terms[c].data() + value * batch.count;
+		return pointers;
 	}
-	kernel_averages.emplace_back(hsv_t{total.sqrt() / (image.width * image.height)});
 }
 
 float comparator_euclidean_t::compare(sampler_interface_t& s1, sampler_interface_t& s2)
@@ -593,6 +769,45 @@ float comparator_mean_sample_euclidean_t::compare(sampler_interface_t& s1, sampl
 	return total / static_cast<float>(s1_v.size());
 }
 
+void comparator_mean_sample_euclidean_t::compare_batch(sampler_interface_t& query, const comparator_batch_t& batch, float* scores)
+{
+	const std::array<float, 3> local_floats = {factor0, factor1, factor2};
+	const auto                 query_v      = query.get_values();
+	check_batch(query_v, batch);
+	std::fill(scores, scores + batch.count, 0.0f);
+	// one sample at a time over every candidate, so the inner loop is straight line arithmetic over the channels
+	std::vector<float> distances(batch.count);
+	for (const auto& [j, value] : blt::enumerate(query_v))
+	{
+		const auto a = value.to_vec3();
+		for (size_t i = 0; i < batch.count; i++)
+		{
+			const auto index  = i * batch.values_per_candidate + j;
+			float      ltotal = 0;
+			for (size_t c = 0; c < 3; c++)
+			{
+				const auto f = a[c] - batch.channels[c][index];
+				ltotal += f * f * local_floats[c];
+			}
+			distances[i] = ltotal;
+		}
+		sqrt_in_place(distances.data(), batch.count);
+		for (size_t i = 0; i < batch.count; i++)
+			scores[i] += distances[i];
+	}
+	for (size_t i = 0; i < batch.count; i++)
+		scores[i] /= static_cast<float>(query_v.size());
+}
+
+namespace
+{
+	// OkLab of the OkLCh value scaled by the comparator factors
+	blt::vec3 weighted_oklab(const blt::color_t& value, const blt::vec3& factors)
+	{
+		return oklch_t(value.as_oklch().to_vec3() * factors).to_oklab().to_vec3();
+	}
+}
+
 float comparator_mean_sample_oklab_euclidean_t::compare(sampler_interface_t& s1, sampler_interface_t& s2)
 {
 	const blt::vec3 local_floats = {factor0, factor1, factor2};
@@ -602,9 +817,8 @@ float comparator_mean_sample_oklab_euclidean_t::compare(sampler_interface_t& s1,
 	float total = 0;
 	for (const auto& [a, b] : blt::in_pairs(s1_v, s2_v))
 	{
-		const blt::vec3 diff = oklch_t(a.as_oklch().to_vec3() * local_floats).to_oklab().to_vec3() - oklch_t(
-								   b.as_oklch().to_vec3() * local_floats).to_oklab().to_vec3();
-		float ltotal = 0;
+		const blt::vec3 diff   = weighted_oklab(a, local_floats) - weighted_oklab(b, local_floats);
+		float           ltotal = 0;
 		for (const auto f : diff)
 			ltotal += f * f;
 		total += std::sqrt(ltotal);
@@ -612,6 +826,24 @@ float comparator_mean_sample_oklab_euclidean_t::compare(sampler_interface_t& s1,
 	return total / static_cast<float>(s1_v.size());
 }
 
+void comparator_mean_sample_oklab_euclidean_t::compare_batch(sampler_interface_t& query, const comparator_batch_t& batch, float* scores)
+{
+	const blt::vec3 local_floats = {factor0, factor1, factor2};
+	const auto      query_v      = query.get_values();
+	check_batch(query_v, batch);
+	// the conversions only depend on the candidate and the factors, so they are done once per plane and factor set
+	const auto terms = get_terms(batch, {batch_terms_kind_t::WEIGHTED_OKLAB, batch.space, batch.count, {factor0, factor1, factor2}},
+								[&batch, &local_floats](const blt::vec3& value) {
+									return weighted_oklab(make_feature_color(batch.space, value), local_floats);
+								});
+
+	std::fill(scores, scores + batch.count, 0.0f);
+	for (const auto& [j, a] : blt::enumerate(query_v))
+		accumulate_distances(weighted_oklab(a, local_floats), blt::vec3{1, 1, 1}, value_terms(*terms, batch, j), batch.count, scores);
+	for (size_t i = 0; i < batch.count; i++)
+		scores[i] /= static_cast<float>(query_v.size());
+}
+
 inline double delta_hue_rad(const double h1_deg, const double h2_deg)
 {
 	const double dh = std::fmod(h2_deg - h1_deg + 540.0, 360.0) - 180.0; // –180 … +180
@@ -653,6 +885,38 @@ inline double delta_e_hsv_weighted(const blt::vec3& a,
 	return std::sqrt(alpha * d_rad2 + beta * dv2);
 }
 
+namespace
+{
+	// sin(h)·s and cos(h)·s, the saturation of an hsv value as a point on the hue circle
+	blt::vec3 hsv_chroma(const blt::vec3& value)
+	{
+		const auto hue = static_cast<float>(blt::toRadians(value[0]));
+		return blt::vec3{std::sin(hue) * value[1], std::cos(hue) * value[1], 0.0f};
+	}
+
+	// the half of the hsv distance that only depends on the first sample, worked out once per query in batches
+	struct hsv_query_t
+	{
+		explicit hsv_query_t(const blt::vec3& a): v{a[2]}
+		{
+			const auto chroma = hsv_chroma(a);
+			x                 = chroma[0] * v;
+			y                 = chroma[1] * v;
+		}
+
+		float x, y, v;
+	};
+
+	// v2 is taken from the first sample, so the value axis never contributes. Same arithmetic as accumulate_distances()
+	float hsv_sample_distance(const hsv_query_t& a, const blt::vec3& b)
+	{
+		const auto chroma = hsv_chroma(b);
+		const auto dx     = a.x - a.v * chroma[0];
+		const auto dy     = a.y - a.v * chroma[1];
+		return std::sqrt(dx * dx + dy * dy);
+	}
+}
+
 float comparator_mean_sample_hsv_euclidean_t::compare(sampler_interface_t& input1, sampler_interface_t& input2)
 {
 	const blt::vec3 local_floats = {factor0, factor1, factor2};
@@ -671,23 +935,11 @@ float comparator_mean_sample_hsv_euclidean_t::compare(sampler_interface_t& input
 		// const float h_dist = std::cos(blt::toRadians(a[0] / 4)) - std::cos(blt::toRadians(b[0] / 4));
 		// l_total += h_dist * h_dist * factor0;
 
-		const auto h1 = a.to_vec3()[0];
-		const auto h2 = b.to_vec3()[0];
-		const auto s1 = a.to_vec3()[1];
-		const auto s2 = b.to_vec3()[1];
-		const auto v1 = a.to_vec3()[2];
-		const auto v2 = a.to_vec3()[2];
-
 		// const auto dh = (std::min(std::abs(h1 - h0), 360 - std::abs(h1 - h0)) / 180.0f) * factor0;
 		// const auto ds = std::abs(s1 - s0) * 0.5 * factor1;
 		// const auto dv = std::abs(v1 - v0) * 0.25 * factor2;
 
-
-		total += static_cast<float>(std::sqrt(
-			std::pow(std::sin(blt::toRadians(h1)) * s1 * v1 - std::sin(blt::toRadians(h2)) * s2 * v2, 2)
-			+ std::pow(std::cos(blt::toRadians(h1)) * s1 * v1 - std::cos(blt::toRadians(h2)) * s2 * v2,
-					   2)
-			+ std::pow(v1 - v2, 2)));
+		total += hsv_sample_distance(hsv_query_t{a.to_vec3()}, b.to_vec3());
 
 		// total += sqrt(l_total);
 		// total += delta_e_hsv_weighted(a * local_floats, b * local_floats);
@@ -695,6 +947,24 @@ float comparator_mean_sample_hsv_euclidean_t::compare(sampler_interface_t& input
 	return total / static_cast<float>(s1_v.size());
 }
 
+void comparator_mean_sample_hsv_euclidean_t::compare_batch(sampler_interface_t& query, const comparator_batch_t& batch, float* scores)
+{
+	const auto query_v = query.get_values();
+	check_batch(query_v, batch);
+	// the factors play no part in the hsv distance, one set of terms serves every query on the plane
+	const auto terms = get_terms(batch, {batch_terms_kind_t::HSV_CHROMA, batch.space, batch.count, {}}, hsv_chroma);
+
+	std::fill(scores, scores + batch.count, 0.0f);
+	for (const auto& [j, a] : blt::enumerate(query_v))
+	{
+		const hsv_query_t prepared{a.to_vec3()};
+		accumulate_distances(blt::vec3{prepared.x, prepared.y, 0.0f}, blt::vec3{prepared.v, prepared.v, 0.0f},
+							value_terms(*terms, batch, j, 2), batch.count, scores);
+	}
+	for (size_t i = 0; i < batch.count; i++)
+		scores[i] /= static_cast<float>(query_v.size());
+}
+
 float comparator_nearest_sample_euclidean_t::compare(sampler_interface_t& s1, sampler_interface_t& s2)
 {
 	const auto s1_v = s1.get_values();
@@ -27,6 +27,7 @@
 #include <sql.h>
 #include <data_loader.h>
 #include <blt/math/log_util.h>
+#include <ranking.h>
 #include <render.h>
 #include <stack>
 #include <tabs.h>
@@ -90,6 +91,7 @@ void check_for_res(std::string path)
 
 void update_current_assets(const assets_t& a)
 {
+	const auto lock = get_ranking_pool().lock_resources();
 	gpu_resources.reset();
 	assets        = a;
 	gpu_resources = gpu_asset_manager{assets};
@@ -171,7 +173,10 @@ void update(const blt::gfx::window_data& data)
 				{
 					item_selected_idx = i;
 					if (gpu_resources)
+					{
+						const auto lock = get_ranking_pool().lock_resources();
 						gpu_resources->update_textures(assets.assets[namespace_str].biome_colors[biome]);
+					}
 				}
 				if (is_selected)
 					ImGui::SetItemDefaultFocus();
@@ -230,7 +235,10 @@ void update(const blt::gfx::window_data& data)
 
 void destroy(const blt::gfx::window_data&)
 {
-	gpu_resources.reset();
+	{
+		const auto lock = get_ranking_pool().lock_resources();
+		gpu_resources.reset();
+	}
 	global_matrices.cleanup();
 	resources.cleanup();
 	renderer_2d.cleanup();
@@ -0,0 +1,273 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2025  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <pixel_format.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__EMSCRIPTEN__) && (defined(__GNUC__) || defined(__clang__))
+#define PIXEL_FORMAT_X86 1
+#include <immintrin.h>
+#define TARGET_F16C __attribute__((target("avx,f16c")))
+#endif
+
+namespace
+{
+	// largest finite half float, anything bigger is clamped to it instead of becoming infinity
+	constexpr float half_max = 65504.0f;
+
+	// stbi_loadf turns 8 bit color into linear values with a plain 2.2 gamma
+	const std::array<float, 256>& gamma_table()
+	{
+		static const auto table = [] {
+			std::array<float, 256> values{};
+			for (size_t i = 0; i < values.size(); i++)
+				values[i] = std::pow(static_cast<float>(i) / 255.0f, 2.2f);
+			return values;
+		}();
+		return table;
+	}
+
+	blt::u8 encode_gamma(const float value)
+	{
+		// nearest entry of the table, so every value that came out of an 8 bit png goes back to exactly its byte
+		const auto& table = gamma_table();
+		const auto  upper = std::lower_bound(table.begin(), table.end(), value);
+		if (upper == table.begin())
+			return 0;
+		if (upper == table.end())
+			return 255;
+		const auto lower = upper - 1;
+		return static_cast<blt::u8>((value - *lower <= *upper - value ? lower : upper) - table.begin());
+	}
+
+	blt::u8 encode_unorm(const float value)
+	{
+		return static_cast<blt::u8>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+	}
+
+	float half_to_float(const blt::u16 half)
+	{
+		const blt::u32 sign     = static_cast<blt::u32>(half & 0x8000u) << 16;
+		const blt::u32 exponent = (half >> 10) & 0x1Fu;
+		const blt::u32 mantissa = half & 0x3FFu;
+		if (exponent == 0x1F)
+			return std::bit_cast<float>(sign | 0x7F800000u | (mantissa << 13));
+		if (exponent != 0)
+			return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+		const auto value = static_cast<float>(mantissa) * 0x1p-24f;
+		return sign != 0 ? -value : value;
+	}
+
+	blt::u16 float_to_half(const float value)
+	{
+		const auto     bits = std::bit_cast<blt::u32>(std::clamp(value, -half_max, half_max));
+		const auto     sign = static_cast<blt::u16>((bits >> 16) & 0x8000u);
+		const blt::u32 abs  = bits & 0x7FFFFFFFu;
+		if (abs > 0x7F800000u)
+			return static_cast<blt::u16>(sign | 0x7E00u);
+		// below the smallest normal half the value is a plain count of 2^-24 steps
+		if (abs < 0x38800000u)
+			return static_cast<blt::u16>(sign | static_cast<blt::u16>(std::nearbyint(std::bit_cast<float>(abs) * 0x1p24f)));
+		// round to nearest even on the 13 mantissa bits being dropped
+		const blt::u32 rounded = abs + 0xFFFu + ((abs >> 13) & 1u);
+		return static_cast<blt::u16>(sign | ((rounded - 0x38000000u) >> 13));
+	}
+
+	void halves_to_floats_scalar(const blt::u16* halves, float* values, const size_t begin, const size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			values[i] = half_to_float(halves[i]);
+	}
+
+	void floats_to_halves_scalar(const float* values, blt::u16* halves, const size_t begin, const size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			halves[i] = float_to_half(values[i]);
+	}
+
+#ifdef PIXEL_FORMAT_X86
+	TARGET_F16C void halves_to_floats_f16c(const blt::u16* halves, float* values, const size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+			_mm256_storeu_ps(values + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(halves + i))));
+		halves_to_floats_scalar(halves, values, i, count);
+	}
+
+	TARGET_F16C void floats_to_halves_f16c(const float* values, blt::u16* halves, const size_t count)
+	{
+		const auto low  = _mm256_set1_ps(-half_max);
+		const auto high = _mm256_set1_ps(half_max);
+		size_t     i    = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto clamped = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(values + i), low), high);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(halves + i), _mm256_cvtps_ph(clamped, _MM_FROUND_TO_NEAREST_INT));
+		}
+		floats_to_halves_scalar(values, halves, i, count);
+	}
+
+	bool has_f16c()
+	{
+		static const bool supported = [] {
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+		}();
+		return supported;
+	}
+#endif
+
+	void halves_to_floats(const blt::u16* halves, float* values, const size_t count)
+	{
+#ifdef PIXEL_FORMAT_X86
+		if (has_f16c())
+			return halves_to_floats_f16c(halves, values, count);
+#endif
+		halves_to_floats_scalar(halves, values, 0, count);
+	}
+
+	void floats_to_halves(const float* values, blt::u16* halves, const size_t count)
+	{
+#ifdef PIXEL_FORMAT_X86
+		if (has_f16c())
+			return floats_to_halves_f16c(values, halves, count);
+#endif
+		floats_to_halves_scalar(values, halves, 0, count);
+	}
+}
+
+size_t bytes_per_pixel(const pixel_format_t format)
+{
+	switch (format)
+	{
+		case pixel_format_t::RGBA16F:
+			return 4 * sizeof(blt::u16);
+		case pixel_format_t::SRGB8:
+		case pixel_format_t::UNORM8:
+			return 4;
+		case pixel_format_t::RGBA32F:
+		default:
+			return 4 * sizeof(float);
+	}
+}
+
+std::optional<pixel_format_t> stored_pixel_format(const size_t bytes, const blt::i32 width, const blt::i32 height)
+{
+	const auto pixels = static_cast<size_t>(std::max(width, 0)) * static_cast<size_t>(std::max(height, 0));
+	for (const auto format : {pixel_format_t::RGBA32F, pixel_format_t::RGBA16F, pixel_format_t::SRGB8})
+	{
+		if (bytes == pixels * bytes_per_pixel(format))
+			return format;
+	}
+	return {};
+}
+
+pixel_format_t display_pixel_format(const pixel_format_t format)
+{
+	return format == pixel_format_t::SRGB8 ? pixel_format_t::UNORM8 : format;
+}
+
+std::vector<std::byte> encode_pixels(const pixel_format_t format, const float* rgba, const size_t count)
+{
+	std::vector<std::byte> pixels(count * bytes_per_pixel(format));
+	switch (format)
+	{
+		case pixel_format_t::RGBA32F:
+			std::memcpy(pixels.data(), rgba, pixels.size());
+			break;
+		case pixel_format_t::RGBA16F:
+			floats_to_halves(rgba, reinterpret_cast<blt::u16*>(pixels.data()), count * 4);
+			break;
+		case pixel_format_t::SRGB8:
+		{
+			auto* bytes = reinterpret_cast<blt::u8*>(pixels.data());
+			for (size_t i = 0; i < count * 4; i += 4)
+			{
+				bytes[i]     = encode_gamma(rgba[i]);
+				bytes[i + 1] = encode_gamma(rgba[i + 1]);
+				bytes[i + 2] = encode_gamma(rgba[i + 2]);
+				bytes[i + 3] = encode_unorm(rgba[i + 3]);
+			}
+			break;
+		}
+		case pixel_format_t::UNORM8:
+		{
+			auto* bytes = reinterpret_cast<blt::u8*>(pixels.data());
+			for (size_t i = 0; i < count * 4; i++)
+				bytes[i] = encode_unorm(rgba[i]);
+			break;
+		}
+	}
+	return pixels;
+}
+
+void expand_pixels(const pixel_format_t format, const std::byte* pixels, const size_t count, float* rgba)
+{
+	switch (format)
+	{
+		case pixel_format_t::RGBA32F:
+			std::memcpy(rgba, pixels, count * bytes_per_pixel(format));
+			break;
+		case pixel_format_t::RGBA16F:
+			halves_to_floats(reinterpret_cast<const blt::u16*>(pixels), rgba, count * 4);
+			break;
+		case pixel_format_t::SRGB8:
+		{
+			const auto& table = gamma_table();
+			const auto* bytes = reinterpret_cast<const blt::u8*>(pixels);
+			for (size_t i = 0; i < count * 4; i += 4)
+			{
+				rgba[i]     = table[bytes[i]];
+				rgba[i + 1] = table[bytes[i + 1]];
+				rgba[i + 2] = table[bytes[i + 2]];
+				rgba[i + 3] = static_cast<float>(bytes[i + 3]) / 255.0f;
+			}
+			break;
+		}
+		case pixel_format_t::UNORM8:
+		{
+			const auto* bytes = reinterpret_cast<const blt::u8*>(pixels);
+			for (size_t i = 0; i < count * 4; i++)
+				rgba[i] = static_cast<float>(bytes[i]) / 255.0f;
+			break;
+		}
+	}
+}
+
+void expand_pixels(const pixel_format_t format, const std::byte* pixels, const size_t count, float* r, float* g, float* b, float* alpha)
+{
+	// small enough to stay in l1, the interleaved values are split into channels while they are still hot
+	constexpr size_t chunk = 256;
+	float            buffer[chunk * 4];
+	const auto       stride = bytes_per_pixel(format);
+	for (size_t begin = 0; begin < count; begin += chunk)
+	{
+		const auto size = std::min(chunk, count - begin);
+		expand_pixels(format, pixels + begin * stride, size, buffer);
+		for (size_t i = 0; i < size; i++)
+		{
+			r[begin + i]     = buffer[i * 4];
+			g[begin + i]     = buffer[i * 4 + 1];
+			b[begin + i]     = buffer[i * 4 + 2];
+			alpha[begin + i] = buffer[i * 4 + 3];
+		}
+	}
+}
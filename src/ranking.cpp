@@ -0,0 +1,137 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2025  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <ranking.h>
+#include <blt/logging/logging.h>
+
+ranking_pool_t::ranking_pool_t(const size_t thread_count)
+{
+	for (size_t i = 0; i < thread_count; i++)
+		threads.emplace_back([this]() { run(); });
+	BLT_DEBUG("Started ranking pool with {} workers", thread_count);
+}
+
+std::shared_ptr<ranking_job_t> ranking_pool_t::submit(ranking_key_t key, ranking_job_t::work_t work)
+{
+	auto job = std::make_shared<ranking_job_t>(std::move(key), std::move(work));
+	// no workers (emscripten builds without pthreads), rank on the calling thread instead
+	if (threads.empty())
+	{
+		if (auto result = job->work(job->cancelled))
+			job->result = std::move(*result);
+		else
+			job->cancelled = true;
+		job->finished.store(true, std::memory_order_release);
+		return job;
+	}
+	{
+		std::scoped_lock lock{queue_mutex};
+		queue.push_back(job);
+	}
+	queue_cv.notify_one();
+	return job;
+}
+
+void ranking_pool_t::submit_background(std::function<void(const std::atomic_bool& cancelled)> task)
+{
+	if (threads.empty())
+		return;
+	auto job = std::make_shared<ranking_job_t>(ranking_key_t{}, [task = std::move(task)](const std::atomic_bool& cancelled) {
+		task(cancelled);
+		return std::optional<ranking_result_t>{};
+	});
+	{
+		std::scoped_lock lock{queue_mutex};
+		background.push_back(std::move(job));
+	}
+	queue_cv.notify_one();
+}
+
+std::unique_lock<std::shared_mutex> ranking_pool_t::lock_resources()
+{
+	{
+		std::scoped_lock lock{queue_mutex};
+		for (auto* jobs : {&queue, &background})
+		{
+			for (const auto& job : *jobs)
+			{
+				job->cancelled = true;
+				job->finished.store(true, std::memory_order_release);
+			}
+			jobs->clear();
+		}
+		for (const auto& job : running)
+			job->cancelled = true;
+	}
+	// running jobs check their cancel flag once per texture so this doesn't wait long
+	return std::unique_lock{resource_mutex};
+}
+
+ranking_pool_t::~ranking_pool_t()
+{
+	{
+		const auto lock = lock_resources();
+		std::scoped_lock queue_lock{queue_mutex};
+		stop = true;
+	}
+	queue_cv.notify_all();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+void ranking_pool_t::run()
+{
+	while (true)
+	{
+		std::shared_ptr<ranking_job_t> job;
+		{
+			std::unique_lock lock{queue_mutex};
+			queue_cv.wait(lock, [this]() { return stop || !queue.empty() || !background.empty(); });
+			if (stop)
+				return;
+			auto& jobs = queue.empty() ? background : queue;
+			job        = std::move(jobs.front());
+			jobs.pop_front();
+			running.push_back(job);
+		}
+
+		if (!job->cancelled)
+		{
+			std::shared_lock resource_lock{resource_mutex};
+			if (auto result = job->work(job->cancelled))
+				job->result = std::move(*result);
+			else
+				job->cancelled = true;
+		}
+
+		{
+			std::scoped_lock lock{queue_mutex};
+			std::erase(running, job);
+		}
+		job->finished.store(true, std::memory_order_release);
+	}
+}
+
+ranking_pool_t& get_ranking_pool()
+{
+#ifdef __EMSCRIPTEN__
+	static ranking_pool_t pool{0};
+#else
+	static ranking_pool_t pool;
+#endif
+	return pool;
+}
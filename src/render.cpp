@@ -19,45 +19,111 @@
 #include <render.h>
 #include <blt/math/log_util.h>
 
-gpu_asset_manager::gpu_asset_manager(assets_t& assets): assets(&assets)
+static size_t next_generation = 1;
+
+// the gpu takes every pixel format as it is, compact textures are never expanded just to be uploaded
+static GLenum gl_pixel_type(const pixel_format_t format)
 {
-	auto ass = assets;
-	for (auto& [namespace_str, data] : ass.assets)
+	switch (format)
 	{
-		for (auto& [image_name, image] : data.images)
+		case pixel_format_t::RGBA16F:
+			return GL_HALF_FLOAT;
+		case pixel_format_t::SRGB8:
+		case pixel_format_t::UNORM8:
+			return GL_UNSIGNED_BYTE;
+		case pixel_format_t::RGBA32F:
+		default:
+			return GL_FLOAT;
+	}
+}
+
+gpu_asset_manager::gpu_asset_manager(assets_t& assets): assets(&assets), generation(next_generation++)
+{
+	// textures with the same blob are identical once prepared the same way, the first one is prepared and uploaded for all of them
+	blt::hashmap_t<blt::i64, const gpu_image_t*> uploaded;
+	const auto make_gpu_image = [&uploaded](image_t image, const bool solid) {
+		if (image.blob != 0)
 		{
-			if (image.width != image.height)
-			{
-				const auto smallest = std::min(image.width, image.height);
-				image.width         = smallest;
-				image.height        = smallest;
-			}
+			const auto found = uploaded.find(image.blob * 2 + solid);
+			if (found != uploaded.end())
+				return gpu_image_t{found->second->image, found->second->texture};
+		}
+		prepare_texture_image(image, solid);
 
-			auto texture = std::make_unique<blt::gfx::texture_gl2D>(image.width, image.height);
-			texture->bind();
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			for (auto& f : image.data)
-				f = blt::linear_to_srgb(f);
+		auto texture = std::make_shared<blt::gfx::texture_gl2D>(image.width, image.height);
+		texture->bind();
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-			texture->upload(image.data.data(), image.width, image.height, GL_RGBA, GL_FLOAT);
+		texture->upload(image.pixels.data(), image.width, image.height, GL_RGBA, gl_pixel_type(image.format));
 
-			resources[namespace_str][image_name] = gpu_image_t{std::move(image), std::move(texture)};
+		return gpu_image_t{std::move(image), std::move(texture)};
+	};
+	const auto remember = [&uploaded](const gpu_image_t& gpu_image, const bool solid) {
+		if (gpu_image.image.blob != 0)
+			uploaded.emplace(gpu_image.image.blob * 2 + solid, &gpu_image);
+	};
+
+	auto ass = assets;
+	// the maps are flat and move their values when they rehash, so every entry exists before any address is remembered
+	for (auto& [namespace_str, data] : ass.assets)
+	{
+		auto& solid_map = resources[namespace_str];
+		for (const auto& [image_name, image] : data.images)
+			solid_map[image_name];
+		auto& non_solid_map = non_solid_resources[namespace_str];
+		for (const auto& [image_name, image] : data.non_solid_images)
+			non_solid_map[image_name];
+	}
+	for (auto& [namespace_str, data] : ass.assets)
+	{
+		auto& solid_map = resources.find(namespace_str)->second;
+		for (auto& [image_name, image] : data.images)
+		{
+			auto& gpu_image = solid_map.find(image_name)->second = make_gpu_image(std::move(image), true);
+			remember(gpu_image, true);
 		}
 
+		auto& non_solid_map = non_solid_resources.find(namespace_str)->second;
 		for (auto& [image_name, image] : data.non_solid_images)
 		{
-			auto texture = std::make_unique<blt::gfx::texture_gl2D>(image.width, image.height);
-			texture->bind();
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			for (auto& f : image.data)
-				f = blt::linear_to_srgb(f);
-			texture->upload(image.data.data(), image.width, image.height, GL_RGBA, GL_FLOAT);
-
-			non_solid_resources[namespace_str][image_name] = gpu_image_t{std::move(image), std::move(texture)};
+			auto& gpu_image = non_solid_map.find(image_name)->second = make_gpu_image(std::move(image), false);
+			remember(gpu_image, false);
+		}
+	}
+	std::vector<const image_t*> images;
+	for (auto& [namespace_str, map] : resources)
+	{
+		for (auto& [image_name, gpu_image] : map)
+		{
+			gpu_image.feature_id = textures.size();
+			textures.push_back(texture_ref_t{namespace_str, image_name, namespace_str + ':' + image_name,
+											 get_symbol_table().intern(namespace_str, image_name), &gpu_image});
+			images.push_back(&gpu_image.image);
 		}
 	}
+	solid_count = textures.size();
+	for (auto& [namespace_str, map] : non_solid_resources)
+	{
+		for (auto& [image_name, gpu_image] : map)
+		{
+			gpu_image.feature_id = textures.size();
+			textures.push_back(texture_ref_t{namespace_str, image_name, namespace_str + ':' + image_name,
+											 get_symbol_table().intern(namespace_str, image_name), &gpu_image});
+			images.push_back(&gpu_image.image);
+		}
+	}
+	features.build(std::move(images));
+
+	// fnv-1a over the names in id order
+	texture_order_hash = 14695981039346656037ull;
+	for (const auto& texture : textures)
+	{
+		for (const char c : texture.full_name)
+			texture_order_hash = (texture_order_hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+		texture_order_hash = (texture_order_hash ^ ',') * 1099511628211ull;
+	}
+
 	// can you tell I've stopped caring about code quality?
 	auto minecraft_namespace = assets.assets.find("minecraft");
 	if (minecraft_namespace != assets.assets.end())
@@ -91,19 +157,31 @@ inline float srgb_to_linear(const float v) noexcept
 
 void gpu_asset_manager::update_textures(biome_color_t color)
 {
-	static auto stmt = assets->db->prepare("SELECT DISTINCT b.namespace, b.block_name, s"
+	generation = next_generation++;
+	biome      = color;
+	// tinted textures move in feature space so every tree and lut has to be rebuilt
+	indexes.clear();
+	luts.clear();
+	const auto& stmt = assets->db->cached("SELECT DISTINCT b.namespace, b.block_name, s"
 		".namespace, s"
 		".name, s"
-		".width, s.height FROM (SELECT * FROM solid_textures UNION SELECT * FROM non_solid_textures) AS s, "
+		".width, s.height FROM (SELECT namespace, name, width, height FROM solid_textures "
+		"UNION SELECT namespace, name, width, height FROM non_solid_textures) AS s, "
 		"models AS m, block_names as b "
 		"WHERE s.namespace = m.texture_namespace AND "
 		"s.name = m.texture AND "
 		"m.namespace = b.model_namespace AND "
 		"m.model = b.model");
 	// hard coded because fuck mojang.
-	auto rows = assets->get_rows<std::string, std::string, std::string, std::string, int, int>(stmt);
 
-	const blt::hashset_t<std::string> grass_blocks{
+	auto&      symbols    = get_symbol_table();
+	const auto intern_all = [&symbols](std::initializer_list<std::string_view> names) {
+		blt::hashset_t<asset_id_t> ids;
+		for (const auto name : names)
+			ids.insert(symbols.intern_full(name));
+		return ids;
+	};
+	static const auto grass_blocks = intern_all({
 		"minecraft:grass_block",
 		"minecraft:short_grass",
 		"minecraft:tall_grass",
@@ -112,8 +190,8 @@ void gpu_asset_manager::update_textures(biome_color_t color)
 		"minecraft:potted_fern",
 		"minecraft:bush",
 		"minecraft:sugar_cane"
-	};
-	const blt::hashset_t<std::string> leaves_blocks{
+	});
+	static const auto leaves_blocks = intern_all({
 		"minecraft:oak_leaves",
 		"minecraft:jungle_leaves",
 		"minecraft:acacia_leaves",
@@ -122,24 +200,28 @@ void gpu_asset_manager::update_textures(biome_color_t color)
 		"minecraft:spruce_leaves",
 		"minecraft:birch_leaves",
 		"minecraft:vine"
-	};
-	for (const auto& [block_namespace, block_name, namespace_str, texture_name, width, height] : rows)
+	});
+	// streamed, most rows are for blocks that are never tinted and are skipped before anything is copied out of them
+	for (const auto [block_namespace, block_name, namespace_view, texture_view, width, height] : stmt.rows<
+			std::string_view, std::string_view, std::string_view, std::string_view, int, int>())
 	{
-		auto fullname = block_namespace + ":" += block_name;
-
-		if (namespace_str == "minecraft" && texture_name == "block/dirt")
+		if (namespace_view == "minecraft" && texture_view == "block/dirt")
 			continue;
 
+		const auto               block = symbols.find(block_namespace, block_name);
 		std::optional<blt::vec3> fill_color;
-		if (grass_blocks.contains(fullname))
+		if (block && grass_blocks.contains(*block))
 			fill_color = color.grass_color;
-		else if (leaves_blocks.contains(fullname))
+		else if (block && leaves_blocks.contains(*block))
 			fill_color = color.leaves_color;
 
 		if (fill_color)
 		{
-			if (texture_name == "block/grass_block_snow")
+			if (texture_view == "block/grass_block_snow")
 				continue;
+			const std::string namespace_str{namespace_view};
+			const std::string texture_name{texture_view};
+			const auto        fullname = std::string{block_namespace}.append(":").append(block_name);
 			// BLT_TRACE("Updating block {} with model {}:{}", fullname, namespace_str, texture_name);
 
 			auto iter = resources.find(namespace_str);
@@ -178,29 +260,39 @@ void gpu_asset_manager::update_textures(biome_color_t color)
 				}
 			}
 
-			auto& map        = tex_iter->second;
-			map.image.width  = width;
-			map.image.height = height;
-			map.image.data   = assets->assets[namespace_str].images[texture_name].data;
-
-			image_t* image = &map.image;
+			auto&       map    = tex_iter->second;
+			const auto& source = assets->assets[namespace_str].images[texture_name];
+			map.image.width    = width;
+			map.image.height   = height;
 
+			auto data = source.expand();
 			for (int x = 0; x < width; x++)
 			{
 				for (int y = 0; y < height; y++)
 				{
-					auto i             = (y * width + x) * 4;
-					image->data[i + 0] = image->data[i + 0] * fill_color->x();
-					image->data[i + 1] = image->data[i + 1] * fill_color->y();
-					image->data[i + 2] = image->data[i + 2] * fill_color->z();
+					auto i      = (y * width + x) * 4;
+					data[i + 0] = data[i + 0] * fill_color->x();
+					data[i + 1] = data[i + 1] * fill_color->y();
+					data[i + 2] = data[i + 2] * fill_color->z();
 				}
 			}
 
 
-			for (auto& f : map.image.data)
+			for (auto& f : data)
 				f = std::pow(f, 1.0f / 2.2f);
 
-			map.texture->upload(map.image.data.data(), map.image.width, map.image.height, GL_RGBA, GL_FLOAT);
+			map.image.format = display_pixel_format(source.format);
+			map.image.pixels = encode_pixels(map.image.format, data.data(), data.size() / 4);
+			// the untinted texture stays with the others sharing the blob
+			if (map.texture.use_count() > 1)
+			{
+				map.texture = std::make_shared<blt::gfx::texture_gl2D>(map.image.width, map.image.height);
+				map.texture->bind();
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			}
+			map.texture->upload(map.image.pixels.data(), map.image.width, map.image.height, GL_RGBA, gl_pixel_type(map.image.format));
+			features.update(map.feature_id);
 		}
 	}
 }
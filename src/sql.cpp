@@ -16,6 +16,8 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <sql.h>
+#include <tuple>
+#include <utility>
 #include <blt/logging/logging.h>
 
 statement_t::statement_t(sqlite3* db, const std::string& stmt): db{db}
@@ -65,7 +67,10 @@ statement_t table_builder_t::build()
 			sql += key.local_name + ") REFERENCES " + key.foreign_table + "(" + key.foreign_name + ")";
 		}
 	}
-	sql += ");";
+	sql += ")";
+	if (!rowid)
+		sql += " WITHOUT ROWID";
+	sql += ";";
 	return statement_t{db, sql};
 }
 
@@ -77,7 +82,180 @@ database_t::database_t(const std::string& file)
 		BLT_DEBUG("Opened database '{}' successfully.", file);
 }
 
+blob_reader_t::blob_reader_t(sqlite3* db, const std::string& table, const std::string& column, const sqlite3_int64 row)
+{
+	if (sqlite3_blob_open(db, "main", table.c_str(), column.c_str(), row, 0, &blob) != SQLITE_OK)
+	{
+		BLT_WARN("Failed to open blob {}.{} of row {} cause '{}'", table, column, row, sqlite3_errmsg(db));
+		// sqlite hands back a handle even when opening fails
+		sqlite3_blob_close(blob);
+		blob = nullptr;
+	}
+}
+
+bool blob_reader_t::reopen(const sqlite3_int64 row)
+{
+	return blob != nullptr && sqlite3_blob_reopen(blob, row) == SQLITE_OK;
+}
+
+bool blob_reader_t::read(void* destination, const size_t bytes, const size_t offset) const
+{
+	if (blob == nullptr || offset + bytes > size())
+		return false;
+	return sqlite3_blob_read(blob, destination, static_cast<int>(bytes), static_cast<int>(offset)) == SQLITE_OK;
+}
+
+blob_reader_t::~blob_reader_t()
+{
+	sqlite3_blob_close(blob);
+}
+
+const statement_t& database_t::cached(const std::string& sql) const
+{
+	if (const auto found = statement_index.find(sql); found != statement_index.end())
+	{
+		statements.splice(statements.begin(), statements, found->second);
+		// the last user may have stopped partway through the rows, bind() resets it
+		found->second->second.bind();
+		return found->second->second;
+	}
+	if (statements.size() >= statement_cache_size)
+	{
+		statement_index.erase(statements.back().first);
+		statements.pop_back();
+	}
+	auto& [key, stmt] = statements.emplace_front(std::piecewise_construct, std::forward_as_tuple(sql), std::forward_as_tuple(db, sql));
+	statement_index.emplace(key, statements.begin());
+	return stmt;
+}
+
 database_t::~database_t()
 {
+	// sqlite refuses to close a connection that still has statements
+	statement_index.clear();
+	statements.clear();
 	sqlite3_close(db);
 }
+
+bool database_t::exec(const std::string& sql) const // NOLINT
+{
+	char* error = nullptr;
+	if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK)
+	{
+		BLT_WARN("Failed to execute '{}' cause '{}'", sql, error != nullptr ? error : sqlite3_errmsg(db));
+		sqlite3_free(error);
+		return false;
+	}
+	return true;
+}
+
+std::optional<std::string> database_t::get_pragma(const std::string& pragma) const
+{
+	const auto stmt = prepare("PRAGMA " + pragma);
+	if (!stmt.execute().has_row())
+		return {};
+	return stmt.fetch().get<std::string>(0);
+}
+
+transaction_t::transaction_t(const database_t& db): db{&db}
+{
+	active = db.exec("BEGIN TRANSACTION");
+}
+
+bool transaction_t::commit()
+{
+	if (!active)
+		return false;
+	active = false;
+	return db->exec("COMMIT");
+}
+
+void transaction_t::rollback()
+{
+	if (!active)
+		return;
+	active = false;
+	db->exec("ROLLBACK");
+}
+
+transaction_t::~transaction_t()
+{
+	rollback();
+}
+
+bulk_ingest_t::bulk_ingest_t(database_t& db, ingest_settings_t settings): db{db}, settings{std::move(settings)}
+{
+	old_journal_mode = db.get_pragma("journal_mode").value_or("DELETE");
+	old_synchronous = db.get_pragma("synchronous").value_or("2");
+	old_cache_size = db.get_pragma("cache_size").value_or("-2000");
+
+	// a no-op once the database has tables, see ingest_settings_t::page_size
+	db.exec("PRAGMA page_size = " + std::to_string(this->settings.page_size));
+	db.exec("PRAGMA journal_mode = " + this->settings.journal_mode);
+	db.exec("PRAGMA synchronous = " + this->settings.synchronous);
+	db.exec("PRAGMA cache_size = " + std::to_string(this->settings.cache_size));
+	transaction.emplace(db);
+}
+
+void bulk_ingest_t::begin_phase(std::string name)
+{
+	end_phase();
+	phase = std::move(name);
+	phase_start = std::chrono::steady_clock::now();
+	phase_rows = 0;
+}
+
+void bulk_ingest_t::end_phase()
+{
+	if (!phase)
+		return;
+	flush();
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - phase_start).count();
+	const auto rate = seconds > 0 ? static_cast<size_t>(static_cast<double>(phase_rows) / seconds) : phase_rows;
+	BLT_INFO("[{}] Stored {} rows in {}s ({} rows/sec)", *phase, phase_rows, seconds, rate);
+	phase.reset();
+}
+
+statement_result_t bulk_ingest_t::execute(const statement_t& stmt) // NOLINT
+{
+	const auto result = stmt.execute();
+	if (result)
+	{
+		++phase_rows;
+		if (++batch_rows >= settings.batch_size)
+			flush();
+	}
+	return result;
+}
+
+void bulk_ingest_t::flush()
+{
+	if (transaction)
+		transaction->commit();
+	batch_rows = 0;
+	transaction.emplace(db);
+}
+
+void bulk_ingest_t::finish()
+{
+	end_phase();
+	if (transaction)
+		transaction->commit();
+	transaction.reset();
+	finished = true;
+}
+
+bulk_ingest_t::~bulk_ingest_t()
+{
+	if (!finished)
+	{
+		if (phase)
+			BLT_WARN("[{}] Ingest was abandoned, rolling back the last {} rows", *phase, batch_rows);
+		phase.reset();
+	}
+	// rolls back whatever finish() did not commit
+	transaction.reset();
+	db.exec("PRAGMA cache_size = " + old_cache_size);
+	db.exec("PRAGMA synchronous = " + old_synchronous);
+	db.exec("PRAGMA journal_mode = " + old_journal_mode);
+}
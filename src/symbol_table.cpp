@@ -0,0 +1,134 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2025  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <symbol_table.h>
+#include <mutex>
+#include <utility>
+
+namespace
+{
+	std::pair<std::string_view, std::string_view> split_full(const std::string_view full_name)
+	{
+		const auto split = full_name.find(':');
+		if (split == std::string_view::npos)
+			return {"minecraft", full_name};
+		return {full_name.substr(0, split), full_name.substr(split + 1)};
+	}
+}
+
+symbol_t symbol_table_t::intern(const std::string_view name)
+{
+	{
+		std::shared_lock lock{mutex};
+		if (const auto found = find_locked(name))
+			return *found;
+	}
+	std::unique_lock lock{mutex};
+	return intern_locked(name);
+}
+
+asset_id_t symbol_table_t::intern(const std::string_view namespace_str, const std::string_view key)
+{
+	{
+		std::shared_lock lock{mutex};
+		const auto       namespace_id = find_locked(namespace_str);
+		const auto       key_id       = find_locked(key);
+		if (namespace_id && key_id)
+			return asset_id_t{*namespace_id, *key_id};
+	}
+	std::unique_lock lock{mutex};
+	return asset_id_t{intern_locked(namespace_str), intern_locked(key)};
+}
+
+asset_id_t symbol_table_t::intern_full(const std::string_view full_name)
+{
+	const auto [namespace_str, key] = split_full(full_name);
+	return intern(namespace_str, key);
+}
+
+std::optional<symbol_t> symbol_table_t::find(const std::string_view name) const
+{
+	std::shared_lock lock{mutex};
+	return find_locked(name);
+}
+
+std::optional<asset_id_t> symbol_table_t::find(const std::string_view namespace_str, const std::string_view key) const
+{
+	std::shared_lock lock{mutex};
+	const auto       namespace_id = find_locked(namespace_str);
+	if (!namespace_id)
+		return {};
+	const auto key_id = find_locked(key);
+	if (!key_id)
+		return {};
+	return asset_id_t{*namespace_id, *key_id};
+}
+
+std::optional<asset_id_t> symbol_table_t::find_full(const std::string_view full_name) const
+{
+	const auto [namespace_str, key] = split_full(full_name);
+	return find(namespace_str, key);
+}
+
+std::string_view symbol_table_t::name(const symbol_t symbol) const
+{
+	std::shared_lock lock{mutex};
+	return names[static_cast<size_t>(symbol)];
+}
+
+std::string symbol_table_t::full_name(const asset_id_t& id) const
+{
+	std::shared_lock lock{mutex};
+	const auto&      namespace_str = names[static_cast<size_t>(id.namespace_id)];
+	const auto&      key           = names[static_cast<size_t>(id.key_id)];
+	std::string      full;
+	full.reserve(namespace_str.size() + 1 + key.size());
+	full += namespace_str;
+	full += ':';
+	full += key;
+	return full;
+}
+
+size_t symbol_table_t::size() const
+{
+	std::shared_lock lock{mutex};
+	return names.size();
+}
+
+symbol_t symbol_table_t::intern_locked(const std::string_view name)
+{
+	// another thread may have added it between dropping the shared lock and taking this one
+	if (const auto found = find_locked(name))
+		return *found;
+	const auto symbol = static_cast<symbol_t>(names.size());
+	symbols.emplace(names.emplace_back(name), symbol);
+	return symbol;
+}
+
+std::optional<symbol_t> symbol_table_t::find_locked(const std::string_view name) const
+{
+	const auto found = symbols.find(name);
+	if (found == symbols.end())
+		return {};
+	return found->second;
+}
+
+symbol_table_t& get_symbol_table()
+{
+	static symbol_table_t table;
+	return table;
+}
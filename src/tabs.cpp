@@ -20,6 +20,7 @@
 #include <data_loader.h>
 #include <filesystem>
 #include <imgui.h>
+#include <ranking.h>
 #include <render.h>
 #include <sql.h>
 #include <stack>
@@ -96,37 +97,6 @@ static void HelpMarker(const std::string& desc)
 }
 
 
-struct min_max_t
-{
-	float min = std::numeric_limits<float>::max(), max = std::numeric_limits<float>::min();
-
-	void with(const float v)
-	{
-		if (v < min)
-			min = v;
-		if (v > max)
-			max = v;
-	}
-
-	[[nodiscard]] float scale() const
-	{
-		return std::abs(max - min);
-	}
-
-	// [[nodiscard]] float normalize(const float f) const { return f; }
-	[[nodiscard]] float normalize(const float f) const
-	{
-		return (f - min) / scale();;
-	}
-
-	void reset()
-	{
-		min = std::numeric_limits<float>::max();
-		max = std::numeric_limits<float>::min();
-	}
-};
-
-
 enum class comparator_mode_t
 {
 	OKLAB, HSV, RGB
@@ -144,30 +114,6 @@ struct tab_data_t
 	};
 
 
-	struct ordering_t
-	{
-		std::string        name;
-		const gpu_image_t* texture;
-		blt::color_t       average;
-		float              dist_avg;
-		float              dist_color;
-		float              dist_kernel;
-
-		ordering_t(std::string         name,
-				   const gpu_image_t*  texture,
-				   const blt::color_t& average,
-				   const float         dist_avg,
-				   const float         dist_color,
-				   const float         dist_kernel) : name{std::move(name)},
-													  texture{texture},
-													  average{average},
-													  dist_avg{dist_avg},
-													  dist_color{dist_color},
-													  dist_kernel{dist_kernel}
-		{}
-	};
-
-
 	struct color_relationship_t
 	{
 		struct value_t
@@ -192,92 +138,332 @@ struct tab_data_t
 	};
 
 
-	void process_resource_for_order(std::vector<ordering_t>& order,
-									const std::string&       namespace_str,
-									const std::string&       name,
-									const gpu_image_t&       images,
-									sampler_interface_t&     sampler,
-									comparator_interface_t&  comparator,
-									std::optional<std::pair<sampler_interface_t&, sampler_interface_t&>>
-									extra_samplers)
+	using source_sampler_func_t = std::function<std::unique_ptr<sampler_interface_t>(const blt::vec3&, int)>;
+
+	// snapshot of everything a ranking needs, owned by the worker so the tab is free to change underneath it
+	struct ranking_query_t
 	{
-		auto       image_sampler = color_sampler_t(images.image, samples);
-		float      dist_diff     = 0;
-		float      dist_kernel   = 0;
-		const auto dist_avg      = comparator.compare(sampler, *image_sampler);
-		if (extra_samplers)
-		{
-			auto& [diff_sampler, kernel_sampler] = *extra_samplers;
-			auto  color_diff                     = color_difference_sampler_t(images.image);
-			auto  color_kernel                   = color_kernel_sampler_t(images.image);
-			dist_diff                            = comparator.compare(diff_sampler, *color_diff);
-			dist_kernel                          = comparator.compare(kernel_sampler, *color_kernel);
-			color_difference_vals.with(dist_diff);
-			kernel_difference_vals.with(dist_kernel);
-		}
-		avg_difference_vals.with(dist_avg);
-
-		order.emplace_back(
-			namespace_str + ":" += name,
-			&images,
-			image_sampler->get_values().front(),
-			dist_avg,
-			dist_diff,
-			dist_kernel);
-	}
+		source_sampler_func_t                   color_source;
+		feature_space_t                         space = feature_space_t::OKLAB;
+		std::unique_ptr<comparator_interface_t> comparator;
+		int                                     comparator_mode   = 0;
+		int                                     samples           = 1;
+		int                                     kernel_size       = 1;
+		int                                     limit             = 0;
+		bool                                    include_non_solid = false;
+		bool                                    enable_noise      = false;
+		bool                                    use_color_lut     = false;
+		bool                                    enable_cutoffs    = false;
+		std::array<float, 3>                    weights{};
+		blt::hashset_t<asset_id_t>              excluded;
+	};
+
+	// precomputed planes for a single query, every texture is compared against these instead of being resampled
+	struct ranking_planes_t
+	{
+		const feature_plane_t& grid;
+		const feature_plane_t& difference;
+		const feature_plane_t& kernel;
+	};
 
-	std::vector<ordering_t> make_ordering(sampler_interface_t&    sampler,
-										  comparator_interface_t& comparator,
-										  std::optional<std::pair<sampler_interface_t&, sampler_interface_t&>>
-										  extra_samplers)
+	// runs on a ranking worker, returns nothing if the query was cancelled part way through
+	static std::optional<ranking_result_t> make_ordering(const ranking_query_t&  query,
+														 const ranking_planes_t& planes,
+														 sampler_interface_t&    sampler,
+														 std::optional<std::pair<sampler_interface_t&, sampler_interface_t&>>
+														 extra_samplers,
+														 const std::atomic_bool& cancelled)
 	{
-		std::vector<ordering_t> order;
-		color_difference_vals.reset();
-		kernel_difference_vals.reset();
-		avg_difference_vals.reset();
-		for (const auto& [namespace_str, data] : gpu_resources->resources)
+		ranking_result_t result;
+		const auto&      textures = gpu_resources->get_textures();
+		const size_t     count    = query.include_non_solid ? textures.size() : gpu_resources->get_solid_count();
+		auto&            comparator = *query.comparator;
+
+		// texture ids are dense, so the first count textures are exactly the first count entries of every plane
+		std::vector<float> dist_avg(count), dist_diff, dist_kernel;
+		comparator.compare_batch(sampler, planes.grid.batch(query.space, count), dist_avg.data());
+		if (extra_samplers)
 		{
-			for (const auto& [name, images] : data)
-				process_resource_for_order(order, namespace_str, name, images, sampler, comparator, extra_samplers);
+			auto& [diff_sampler, kernel_sampler] = *extra_samplers;
+			dist_diff.resize(count);
+			dist_kernel.resize(count);
+			comparator.compare_batch(diff_sampler, planes.difference.batch(query.space, count), dist_diff.data());
+			comparator.compare_batch(kernel_sampler, planes.kernel.batch(query.space, count), dist_kernel.data());
 		}
+		if (cancelled)
+			return {};
 
-		if (include_non_solid)
+		result.ordering.reserve(count);
+		for (size_t i = 0; i < count; i++)
 		{
-			for (const auto& [namespace_str, data] : gpu_resources->non_solid_resources)
+			const auto& texture = textures[i];
+			if (query.excluded.contains(texture.id))
+				continue;
+			if (extra_samplers)
 			{
-				for (const auto& [name, images] : data)
-					process_resource_for_order(order, namespace_str, name, images, sampler, comparator, extra_samplers);
+				result.color_difference_vals.with(dist_diff[i]);
+				result.kernel_difference_vals.with(dist_kernel[i]);
 			}
+			result.avg_difference_vals.with(dist_avg[i]);
+			result.ordering.emplace_back(texture.id,
+										 texture.image,
+										 make_feature_color(query.space, planes.grid.get(i, 0)),
+										 dist_avg[i],
+										 extra_samplers ? dist_diff[i] : 0.0f,
+										 extra_samplers ? dist_kernel[i] : 0.0f);
 		}
 
-		auto l_weights = weights;
+		auto l_weights = query.weights;
 
-		if (!enable_noise || !extra_samplers)
+		if (!query.enable_noise || !extra_samplers)
 		{
 			l_weights[1] = 0;
 			l_weights[2] = 0;
 		}
 
-		std::stable_sort(order.begin(),
-						 order.end(),
-						 [&l_weights, this](const ordering_t& a, const ordering_t& b) {
+		const auto& avg_vals    = result.avg_difference_vals;
+		const auto& color_vals  = result.color_difference_vals;
+		const auto& kernel_vals = result.kernel_difference_vals;
+		std::stable_sort(result.ordering.begin(),
+						 result.ordering.end(),
+						 [&](const ordering_t& a, const ordering_t& b) {
 							 const auto a_avg =
-								 l_weights[0] * avg_difference_vals.normalize(a.dist_avg) + l_weights[1] *
-								 color_difference_vals.normalize(a.dist_color) + l_weights[2] * kernel_difference_vals.
-								 normalize(a.dist_kernel);
+								 l_weights[0] * avg_vals.normalize(a.dist_avg) + l_weights[1] *
+								 color_vals.normalize(a.dist_color) + l_weights[2] * kernel_vals.normalize(a.dist_kernel);
 							 const auto b_avg =
-								 l_weights[0] * avg_difference_vals.normalize(b.dist_avg) + l_weights[1] *
-								 color_difference_vals.normalize(b.dist_color) + l_weights[2] * kernel_difference_vals.
-								 normalize(b.dist_kernel);
+								 l_weights[0] * avg_vals.normalize(b.dist_avg) + l_weights[1] *
+								 color_vals.normalize(b.dist_color) + l_weights[2] * kernel_vals.normalize(b.dist_kernel);
 							 return a_avg < b_avg;
 						 });
 
-		return order;
+		if (cancelled)
+			return {};
+		return result;
+	}
+
+	/**
+	 * Answers a query with only the closest query.limit textures from a vp tree over the sample grids. The full scan sorts
+	 * by a normalized dist_avg when noise is off, so taking the nearest textures gives the same order as the front of it.
+	 */
+	static std::optional<ranking_result_t> make_nearest_ordering(const ranking_query_t&  query,
+																 const ranking_planes_t& planes,
+																 sampler_interface_t&    sampler,
+																 const std::atomic_bool& cancelled)
+	{
+		auto&                     comparator = *query.comparator;
+		const texture_index_key_t index_key{
+			query.space,
+			query.samples,
+			query.comparator_mode,
+			{comparator.factor0, comparator.factor1, comparator.factor2}
+		};
+		const auto index = gpu_resources->indexes.get(index_key, planes.grid, comparator);
+
+		const auto&       textures    = gpu_resources->get_textures();
+		const size_t      solid_count = gpu_resources->get_solid_count();
+		sampler_feature_t image_sampler{planes.grid, 0, query.space};
+		const auto        nearest     = index->nearest(
+			static_cast<size_t>(query.limit),
+			[&](const size_t id) {
+				image_sampler.set_texture(id);
+				return comparator.compare(sampler, image_sampler);
+			},
+			[&](const size_t id) {
+				return (query.include_non_solid || id < solid_count) && !query.excluded.contains(textures[id].id);
+			},
+			cancelled);
+		if (cancelled)
+			return {};
+		return make_nearest_result(query, planes, nearest);
+	}
+
+	/**
+	 * Ranks only the textures the color lut stored around the query color, nearly always the same as asking the vp tree.
+	 * Returns nothing if the lut can't provide query.limit textures, the caller falls back to the tree.
+	 */
+	static std::optional<ranking_result_t> make_lut_ordering(const ranking_query_t&  query,
+															 const ranking_planes_t& planes,
+															 const color_lut_t&      lut,
+															 const blt::vec3&        color,
+															 sampler_interface_t&    sampler)
+	{
+		const auto limit = static_cast<size_t>(query.limit);
+		if (limit > color_lut_t::point_textures)
+			return {};
+
+		const auto&                         textures = gpu_resources->get_textures();
+		std::vector<vp_tree_t::neighbour_t> nearest;
+		sampler_feature_t                   image_sampler{planes.grid, 0, query.space};
+		for (const auto id : lut.candidates(color))
+		{
+			if (query.excluded.contains(textures[id].id))
+				continue;
+			image_sampler.set_texture(id);
+			nearest.push_back(vp_tree_t::neighbour_t{id, query.comparator->compare(sampler, image_sampler)});
+		}
+		if (nearest.size() < limit)
+			return {};
+		std::sort(nearest.begin(), nearest.end(), [](const auto& a, const auto& b) {
+			return std::pair{a.distance, a.id} < std::pair{b.distance, b.id};
+		});
+		nearest.resize(limit);
+		return make_nearest_result(query, planes, nearest);
+	}
+
+	static ranking_result_t make_nearest_result(const ranking_query_t&                     query,
+												const ranking_planes_t&                    planes,
+												const std::vector<vp_tree_t::neighbour_t>& nearest)
+	{
+		const auto&      textures = gpu_resources->get_textures();
+		ranking_result_t result;
+		result.ordering.reserve(nearest.size());
+		for (const auto& [id, distance] : nearest)
+		{
+			const auto& texture = textures[id];
+			result.avg_difference_vals.with(distance);
+			result.ordering.emplace_back(texture.id,
+										 texture.image,
+										 make_feature_color(query.space, planes.grid.get(id, 0)),
+										 distance,
+										 0.0f,
+										 0.0f);
+		}
+		return result;
 	}
 
-	[[nodiscard]] blt::hashset_t<std::string> get_blocks_control_list() const
+	[[nodiscard]] ranking_key_t make_ranking_key(const blt::vec3& color, std::string block = "") const
 	{
-		blt::hashset_t<std::string> blocks;
+		ranking_key_t key;
+		key.color               = {color[0], color[1], color[2]};
+		key.block               = std::move(block);
+		key.color_mode          = static_cast<int>(selected_color_mode);
+		key.comparator_mode     = static_cast<int>(selected_comparator);
+		key.samples             = samples;
+		key.kernel_size         = kernel_size;
+		key.factors             = {comparison_interface->factor0, comparison_interface->factor1, comparison_interface->factor2};
+		key.weights             = weights;
+		key.include_non_solid   = include_non_solid;
+		key.enable_noise        = enable_noise;
+		key.use_color_lut       = use_color_lut;
+		key.enable_cutoffs      = enable_cutoffs;
+		key.limit               = images;
+		key.filter_generation   = filter_generation;
+		key.resource_generation = gpu_resources->get_generation();
+		return key;
+	}
+
+	[[nodiscard]] ranking_job_t::work_t make_ranking_work(const ranking_key_t& key) const
+	{
+		auto query               = std::make_shared<ranking_query_t>();
+		query->color_source      = color_source_t;
+		query->space             = feature_space;
+		query->comparator        = comparison_interface->clone();
+		query->comparator_mode   = static_cast<int>(selected_comparator);
+		query->samples           = std::clamp(samples, 1, texture_feature_store_t::max_samples);
+		query->kernel_size       = kernel_size;
+		query->limit             = images;
+		query->include_non_solid = include_non_solid;
+		query->enable_noise      = enable_noise;
+		query->use_color_lut     = use_color_lut;
+		query->enable_cutoffs    = enable_cutoffs;
+		query->weights           = weights;
+		query->excluded          = list;
+		for (const auto& block : skipped_blocks)
+			query->excluded.insert(block);
+		if (const auto selected = get_symbol_table().find_full(selected_block); !selected_block.empty() && selected)
+			query->excluded.insert(*selected);
+
+		const gpu_image_t* block_texture = key.block.empty() ? nullptr : selected_block_texture;
+
+		return [query, block_texture, color = blt::vec3{key.color}, generation = key.resource_generation](
+			const std::atomic_bool& cancelled) -> std::optional<ranking_result_t> {
+			// the textures were rebuilt after this was queued, anything we'd produce would point at freed images
+			if (!gpu_resources || gpu_resources->get_generation() != generation)
+				return {};
+			const auto&            features = gpu_resources->features;
+			const ranking_planes_t planes{
+				features.grid(query->space, query->samples),
+				features.difference(query->space),
+				features.kernel(query->space, query->kernel_size)
+			};
+			// noise changes the order away from plain dist_avg and the cutoffs filter on the noise distances, those rankings
+			// still need every texture scored. The cutoffs also take their slider ranges from every texture's distances
+			const bool use_index = query->comparator->is_metric() && query->limit > 0 && query->weights[0] > 0 &&
+								   (block_texture == nullptr || (!query->enable_noise && !query->enable_cutoffs));
+			if (block_texture == nullptr)
+			{
+				const auto sampler = query->color_source(color, query->samples);
+				if (use_index && query->use_color_lut)
+				{
+					const auto&           comparator = *query->comparator;
+					const color_lut_key_t lut_key{
+						query->space,
+						query->samples,
+						query->comparator_mode,
+						{comparator.factor0, comparator.factor1, comparator.factor2},
+						query->include_non_solid,
+						generation
+					};
+					if (const auto lut = gpu_resources->luts.find(lut_key, query->color_source, comparator))
+					{
+						if (auto result = make_lut_ordering(*query, planes, *lut, color, *sampler))
+							return result;
+					}
+				}
+				if (use_index)
+					return make_nearest_ordering(*query, planes, *sampler, cancelled);
+				return make_ordering(*query, planes, *sampler, {}, cancelled);
+			}
+			const auto        id = block_texture->feature_id;
+			sampler_feature_t image_sampler{planes.grid, id, query->space};
+			if (use_index)
+				return make_nearest_ordering(*query, planes, image_sampler, cancelled);
+			sampler_feature_t color_sampler{planes.difference, id, query->space};
+			sampler_feature_t kernel_sampler{planes.kernel, id, query->space};
+			return make_ordering(*query,
+								 planes,
+								 image_sampler,
+								 std::pair<sampler_interface_t&, sampler_interface_t&>{color_sampler, kernel_sampler},
+								 cancelled);
+		};
+	}
+
+	/**
+	 * Swaps in the result of a finished ranking job and makes sure the slot is working towards key. Cached results are
+	 * shown immediately, anything else is handed to the ranking pool. Returns the ranking to display if it changed.
+	 */
+	const ranking_result_t* update_ranking(ranking_slot_t& slot, const ranking_key_t& key)
+	{
+		const ranking_result_t* ready = nullptr;
+		if (const auto done = slot.take_finished())
+			ready = &ranking_cache.insert(done->key, std::move(done->result));
+		if (slot.wants(key))
+		{
+			if (const auto cached = ranking_cache.find(key))
+			{
+				slot.show(key);
+				ready = cached;
+			} else
+				slot.submit(get_ranking_pool().submit(key, make_ranking_work(key)));
+		}
+		return ready;
+	}
+
+	void show_ranking(const ranking_key_t& key)
+	{
+		if (const auto result = update_ranking(ordered_ranking, key))
+		{
+			ordered_images         = result->ordering;
+			avg_difference_vals    = result->avg_difference_vals;
+			color_difference_vals  = result->color_difference_vals;
+			kernel_difference_vals = result->kernel_difference_vals;
+		}
+	}
+
+	[[nodiscard]] blt::hashset_t<asset_id_t> get_blocks_control_list() const
+	{
+		auto&                      symbols = get_symbol_table();
+		blt::hashset_t<asset_id_t> blocks;
 		const auto                  sections = blt::string::split(control_list, ',');
 		for (const auto& section : sections)
 		{
@@ -306,20 +492,19 @@ struct tab_data_t
 					continue;
 				if (parts.size() == 1)
 					parts.insert(parts.begin(), "minecraft");
-				blocks.insert(parts[0] + ":" += parts[1]);
+				// a block nothing was loaded for has no symbol and no textures either
+				if (const auto block = symbols.find(parts[0], parts[1]))
+					blocks.insert(*block);
 			}
 		}
-		blt::hashset_t<std::string> list;
-		for (const auto& str : blocks)
+		blt::hashset_t<asset_id_t> list;
+		for (const auto& [namespace_id, block_id] : blocks)
 		{
-			auto parts = blt::string::split(str, ':');
-			if (parts.empty())
-				continue;
-			auto it = assets.assets.find(parts[0]);
+			auto it = assets.assets.find(symbols.name(namespace_id));
 			if (it == assets.assets.end())
 				continue;
-			auto [_, ns] = *it;
-			auto it2     = ns.block_to_textures.find(parts[1]);
+			const auto& [_, ns] = *it;
+			auto it2            = ns.block_to_textures.find(symbols.name(block_id));
 			if (it2 == ns.block_to_textures.end())
 				continue;
 			auto& [block_name, textures] = *it2;
@@ -333,9 +518,9 @@ struct tab_data_t
 	{
 		if (selected_block_texture != nullptr)
 		{
-			const auto sampler = color_sampler_t(selected_block_texture->image, samples);
-			const auto value   = sampler->get_values().front();
-			auto       vec3    = value.to_vec3();
+			const auto& plane = gpu_resources->features.mean(feature_space);
+			const auto  value = make_feature_color(feature_space, plane.get(selected_block_texture->feature_id, 0));
+			auto        vec3  = value.to_vec3();
 			ImGui::Text("Image Color: (%f, %f, %f)", vec3[0], vec3[1], vec3[2]);
 			ImGui::SameLine();
 			if (ImGui::Button("Copy"))
@@ -349,6 +534,7 @@ struct tab_data_t
 		if (ImGui::InputText("Access Control String", &control_list))
 		{
 			list = get_blocks_control_list();
+			++filter_generation;
 			pending_change |= true;
 		}
 		ImGui::SameLine();
@@ -383,6 +569,14 @@ struct tab_data_t
 			pending_change |= true;
 		}
 		pending_change |= ImGui::Checkbox("Extra Items", &include_non_solid);
+		if (configured != BLOCK_SELECT)
+		{
+			ImGui::SameLine();
+			pending_change |= ImGui::Checkbox("Use Color Lookup Table", &use_color_lut);
+			ImGui::SameLine();
+			HelpMarker("Builds a table of the closest blocks to every color in the background, once it is ready changing the color "
+				"is nearly free. Results can very rarely differ from a full search. Not used with the HSV color mode.");
+		}
 		switch (selected_color_mode)
 		{
 			case color_mode_t::COLOR_RGB:
@@ -418,6 +612,11 @@ struct tab_data_t
 				ImGui::SameLine();
 				pending_change |= ImGui::SliderFloat("Kernel Difference Weight", &weights[2], 0, 1);
 				ImGui::SameLine();
+				pending_change |= ImGui::SliderInt("Kernel Size", &kernel_size, 1, texture_feature_store_t::max_kernel_size);
+				ImGui::SameLine();
+				HelpMarker("Pixels on each side of the box the kernel difference averages over. Sizes other than 1 are computed for "
+					"every block the first time they are used.");
+				ImGui::SameLine();
 			}
 
 			if (enable_cutoffs)
@@ -439,6 +638,7 @@ struct tab_data_t
 			samples = 1;
 		if (samples > 8)
 			samples = 8;
+		kernel_size = std::clamp(kernel_size, 1, texture_feature_store_t::max_kernel_size);
 	}
 
 	void draw_blocks2(std::vector<ordering_t>& ordered_images, const std::string& table_id)
@@ -449,18 +649,20 @@ struct tab_data_t
 		if (ordered_images.empty())
 			return;
 		const auto amount_per_line = static_cast<int>(std::max(std::sqrt(images), 4.0));
+		const auto selected        = selected_block.empty() ? std::nullopt : get_symbol_table().find_full(selected_block);
+		const auto& textures       = gpu_resources->get_textures();
 
-		const auto iter = blt::enumerate(ordered_images).filter([this](const auto& beep) {
+		const auto iter = blt::enumerate(ordered_images).filter([this, &selected](const auto& beep) {
 			const auto& [index, image] = beep;
 			if (enable_cutoffs && image.dist_color > cutoff_color_difference)
 				return false;
 			if (enable_cutoffs && image.dist_kernel > cutoff_kernel_difference)
 				return false;
-			if (skipped_index.contains(index))
+			if (skipped_blocks.contains(image.id))
 				return false;
-			if (list.contains(image.name))
+			if (list.contains(image.id))
 				return false;
-			if (!selected_block.empty() && image.name == selected_block)
+			if (selected && image.id == *selected)
 				return false;
 			return true;
 		});
@@ -478,7 +680,8 @@ struct tab_data_t
 				if (begin == iter.end())
 					continue;
 				auto  [index, tab_order]                                          = (*begin).value();
-				auto& [name, texture, average, distance, color_dist, kernel_dist] = tab_order;
+				auto& [id, texture, average, distance, color_dist, kernel_dist] = tab_order;
+				const auto& name = textures[texture->feature_id].full_name;
 
 				ImGui::Image(texture->texture->getTextureID(),
 							 ImVec2{
@@ -507,7 +710,10 @@ struct tab_data_t
 					}
 					ImGui::Separator();
 					if (ImGui::Button("Remove"))
-						skipped_index.insert(index);
+					{
+						skipped_blocks.insert(id);
+						++filter_generation;
+					}
 					ImGui::Separator();
 					if (ImGui::Button("Close"))
 						ImGui::CloseCurrentPopup();
@@ -518,6 +724,14 @@ struct tab_data_t
 		}
 	}
 
+	void clear_skipped_blocks()
+	{
+		if (skipped_blocks.empty())
+			return;
+		skipped_blocks.clear();
+		++filter_generation;
+	}
+
 	void draw_order(std::vector<ordering_t>& ordered_images)
 	{
 		draw_blocks(ordered_images, "ImageSelectionTable");
@@ -527,13 +741,7 @@ struct tab_data_t
 	{
 		if (rel.colors.empty())
 			return;
-		auto& selector = rel.colors[color_index];
-		{
-			auto sampler = color_source_t(blt::vec3{selector.current_color},
-										  samples);
-
-			selector.ordering = make_ordering(*sampler, *comparison_interface, {});
-		}
+		const auto& selector = rel.colors[color_index];
 
 		const auto current_offset = selector.offset;
 		for (const auto& [i, e] : blt::enumerate(rel.colors))
@@ -561,13 +769,6 @@ struct tab_data_t
 					break;
 				}
 			}
-
-
-			auto sampler = color_source_t(
-				blt::vec3{e.current_color},
-				samples);
-
-			e.ordering = make_ordering(*sampler, *comparison_interface, {});
 		}
 		// BLT_TRACE("------");
 	}
@@ -687,7 +888,7 @@ struct tab_data_t
 										ImGuiColorEditFlags_InputRGB |
 										ImGuiColorEditFlags_PickerHueBar))
 				{
-					skipped_index.clear();
+					clear_skipped_blocks();
 				}
 				if (ImGui::Button("Paste"))
 				{
@@ -700,9 +901,7 @@ struct tab_data_t
 				ImGui::EndChild();
 
 				ImGui::Text("Click the image icon to remove it from the list. This is reset when the color changes.");
-				auto sampler = color_source_t(blt::vec3{color_picker_data}, samples);
-
-				ordered_images = make_ordering(*sampler, *comparison_interface, {});
+				show_ranking(make_ranking_key(blt::vec3{color_picker_data}));
 
 				draw_config_tools();
 
@@ -724,7 +923,7 @@ struct tab_data_t
 											ImGuiColorEditFlags_InputRGB |
 											ImGuiColorEditFlags_PickerHueBar))
 					{
-						skipped_index.clear();
+						clear_skipped_blocks();
 					}
 					ImGui::EndChild();
 					if (ImGui::Button("Paste"))
@@ -732,9 +931,7 @@ struct tab_data_t
 						if (auto color        = history_stack.get_color())
 							color_picker_data = color->as_linear_rgb().unpack();
 					}
-					auto sampler = color_source_t(blt::vec3{color_picker_data}, samples);
-
-					ordered_images = make_ordering(*sampler, *comparison_interface, {});
+					show_ranking(make_ranking_key(blt::vec3{color_picker_data}));
 					ImGui::Text("Click the image icon to remove it from the list. This is reset when the color changes.");
 					draw_config_tools();
 					ImGui::EndChild();
@@ -750,7 +947,7 @@ struct tab_data_t
 					ImGui::InputText("##InputSearch", &input_buf);
 					if (!asset_rows)
 					{
-						static auto stmt = assets.db->prepare(
+						const auto& stmt = assets.db->cached(
 							"SELECT DISTINCT models.texture_namespace, models.texture "
 							"FROM models INNER JOIN block_names ON "
 							"block_names.model_namespace=models.namespace AND block_names.model=models.model "
@@ -759,20 +956,20 @@ struct tab_data_t
 					}
 					const auto scale = static_cast<int>(avail.x / (16 * 5));
 
-					static auto delete_models_stmt = assets.db->prepare(
+					const auto& delete_models_stmt = assets.db->cached(
 						"DELETE FROM models WHERE texture_namespace=? AND texture=?");
 
-					static auto delete_textures_stmt = assets.db->prepare(
+					const auto& delete_textures_stmt = assets.db->cached(
 						"DELETE FROM non_solid_textures WHERE namespace=? AND name=?");
 
-					static auto delete_textures2_stmt = assets.db->prepare(
+					const auto& delete_textures2_stmt = assets.db->cached(
 						"DELETE FROM solid_textures WHERE namespace=? AND name=?");
 
-					static auto delete_blocks_stmt = assets.db->prepare("DELETE FROM block_names WHERE "
+					const auto& delete_blocks_stmt = assets.db->cached("DELETE FROM block_names WHERE "
 						"(SELECT COUNT(*) "
 						"FROM models WHERE models.namespace=block_names.model_namespace AND models.model=block_names.model) = 0");
 
-					const std::array<statement_t*, 4> statements{
+					const std::array<const statement_t*, 4> statements{
 						&delete_models_stmt,
 						&delete_textures_stmt,
 						&delete_textures2_stmt,
@@ -924,19 +1121,8 @@ struct tab_data_t
 						ImGui::Text("Block: %s", block_pretty_name(selected_block).c_str());
 						ImGui::Image(selected_block_texture->texture->getTextureID(), ImVec2{64, 64});
 
-						if (pending_change)
-						{
-							const auto image_sampler  = color_sampler_t(selected_block_texture->image, samples);
-							const auto color_sampler  = color_difference_sampler_t(selected_block_texture->image);
-							const auto kernel_sampler = color_kernel_sampler_t(selected_block_texture->image);
-
-							ordered_images = make_ordering(*image_sampler,
-														   *comparison_interface,
-														   std::pair<sampler_interface_t&, sampler_interface_t&>{
-															   *color_sampler,
-															   *kernel_sampler});
-							pending_change = false;
-						}
+						show_ranking(make_ranking_key(blt::vec3{}, selected_block));
+						pending_change = false;
 
 						ImGui::Text(
 							"Click the image icon to remove it from the list. This is reset when the block changes.");
@@ -992,6 +1178,15 @@ struct tab_data_t
 							pending_change = false;
 						}
 
+						if (wheel_rankings.size() != current_mode.colors.size())
+							wheel_rankings.resize(current_mode.colors.size());
+						for (size_t i = 0; i < current_mode.colors.size(); i++)
+						{
+							auto& value = current_mode.colors[i];
+							if (const auto result = update_ranking(wheel_rankings[i], make_ranking_key(value.current_color)))
+								value.ordering = result->ordering;
+						}
+
 						// auto av2 = ImGui::GetContentRegionAvail();
 						if (ImGui::BeginChild("##ColorContainers",
 											  ImVec2(0, 0),
@@ -1128,22 +1323,28 @@ struct tab_data_t
 	bool                        pending_change           = true;
 	bool                        enable_noise             = false;
 	bool                        enable_cutoffs           = false;
+	bool                        use_color_lut            = true;
 	float                       cutoff_color_difference  = 0;
 	float                       cutoff_kernel_difference = 0;
 	tab_type_t                  configured               = UNCONFIGURED;
 	int                         images                   = 16;
 	int                         samples                  = 1;
+	int                         kernel_size              = 1;
 	color_mode_t                selected_color_mode      = color_mode_t::COLOR_OKLAB;
 	int                         selected_conversion_mode = 0;
 	min_max_t                   avg_difference_vals;
 	min_max_t                   color_difference_vals;
 	min_max_t                   kernel_difference_vals;
 	std::array<float, 3>        color_picker_data{};
-	blt::hashset_t<int>         skipped_index;
-	blt::hashset_t<std::string> list;
+	blt::hashset_t<asset_id_t>  skipped_blocks;
+	size_t                      filter_generation = 0;
+	blt::hashset_t<asset_id_t>  list;
 	size_t                      id;
 	std::array<float, 3>        weights{0.5, 0.15, 0.40};
 	std::vector<ordering_t>     ordered_images;
+	ranking_cache_t             ranking_cache;
+	ranking_slot_t              ordered_ranking;
+	std::vector<ranking_slot_t> wheel_rankings;
 
 	std::unique_ptr<comparator_interface_t> comparison_interface =
 		std::make_unique<comparator_mean_sample_oklab_euclidean_t>();
@@ -1275,46 +1476,35 @@ struct tab_data_t
 		return hue;
 	}
 
-	std::function<std::unique_ptr<sampler_interface_t>(const image_t&, int)>   color_sampler_t = make_sampler_oklab();
 	std::function<std::unique_ptr<sampler_interface_t>(const blt::vec3&, int)> color_source_t = make_source_oklab();
-	std::function<std::unique_ptr<sampler_interface_t>(const image_t&)>        color_difference_sampler_t =
-		make_difference_oklab();
-	std::function<std::unique_ptr<sampler_interface_t>(const image_t&)> color_kernel_sampler_t = make_kernel_oklab();
+	feature_space_t                                                            feature_space  = feature_space_t::OKLAB;
 
 	void switch_to_oklab()
 	{
-		color_sampler_t            = make_sampler_oklab();
-		color_source_t             = make_source_oklab();
-		color_difference_sampler_t = make_difference_oklab();
-		color_kernel_sampler_t     = make_kernel_oklab();
-		pending_change             = true;
+		color_source_t = make_source_oklab();
+		feature_space  = feature_space_t::OKLAB;
+		pending_change = true;
 	}
 
 	void switch_to_linrgb()
 	{
-		color_sampler_t            = make_sampler_linrgb();
-		color_source_t             = make_source_linrgb();
-		color_difference_sampler_t = make_difference_linrgb();
-		color_kernel_sampler_t     = make_kernel_linrgb();
-		pending_change             = true;
+		color_source_t = make_source_linrgb();
+		feature_space  = feature_space_t::LINEAR_RGB;
+		pending_change = true;
 	}
 
 	void switch_to_srgb()
 	{
-		color_sampler_t            = make_sampler_srgb();
-		color_source_t             = make_source_srgb();
-		color_difference_sampler_t = make_difference_srgb();
-		color_kernel_sampler_t     = make_kernel_srgb();
-		pending_change             = true;
+		color_source_t = make_source_srgb();
+		feature_space  = feature_space_t::SRGB;
+		pending_change = true;
 	}
 
 	void switch_to_hsv()
 	{
-		color_sampler_t            = make_sampler_hsv();
-		color_source_t             = make_source_hsv();
-		color_difference_sampler_t = make_difference_hsv();
-		color_kernel_sampler_t     = make_kernel_hsv();
-		pending_change             = true;
+		color_source_t = make_source_hsv();
+		feature_space  = feature_space_t::HSV;
+		pending_change = true;
 	}
 
 	static std::function<std::unique_ptr<sampler_interface_t>(const blt::vec3&, int)> make_source_oklab()
@@ -1347,92 +1537,6 @@ struct tab_data_t
 				sampler_single_value_t>(blt::color::linear_rgb_t{image}.to_hsv(), samples * samples);
 		};
 	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&, int)> make_sampler_oklab()
-	{
-		return [](
-			const image_t& image,
-			int            samples) {
-			return std::make_unique<sampler_oklab_op_t>(image, samples);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&, int)> make_sampler_linrgb()
-	{
-		return [](const image_t& image, int samples) {
-			return std::make_unique<sampler_linear_rgb_op_t>(image, samples);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&, int)> make_sampler_srgb()
-	{
-		return [](const image_t& image, int samples) {
-			return std::make_unique<sampler_srgb_op_t>(image, samples);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&, int)> make_sampler_hsv()
-	{
-		return [](const image_t& image, int samples) {
-			return std::make_unique<sampler_hsv_op_t>(image, samples);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&)> make_difference_oklab()
-	{
-		return [](const image_t& image) {
-			return std::make_unique<sampler_color_difference_oklab_t>(image);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&)> make_difference_linrgb()
-	{
-		return [](const image_t& image) {
-			return std::make_unique<sampler_color_difference_rgb_t>(image);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&)> make_difference_srgb()
-	{
-		return [](const image_t& image) {
-			return std::make_unique<sampler_color_difference_srgb_t>(image);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&)> make_difference_hsv()
-	{
-		return [](const image_t& image) {
-			return std::make_unique<sampler_color_difference_hsv_t>(image);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&)> make_kernel_oklab()
-	{
-		return [](const image_t& image) {
-			return std::make_unique<sampler_kernel_filter_oklab_t>(image);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&)> make_kernel_linrgb()
-	{
-		return [](const image_t& image) {
-			return std::make_unique<sampler_kernel_filter_rgb_t>(image);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&)> make_kernel_srgb()
-	{
-		return [](const image_t& image) {
-			return std::make_unique<sampler_kernel_filter_srgb_t>(image);
-		};
-	}
-
-	static std::function<std::unique_ptr<sampler_interface_t>(const image_t&)> make_kernel_hsv()
-	{
-		return [](const image_t& image) {
-			return std::make_unique<sampler_kernel_filter_hsv_t>(image);
-		};
-	}
 };
 
 
@@ -0,0 +1,290 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2025  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <texture_features.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <blt/logging/logging.h>
+
+using namespace blt::color;
+
+void prepare_texture_image(image_t& image, const bool solid)
+{
+	if (solid && image.width != image.height)
+	{
+		const auto smallest = std::min(image.width, image.height);
+		image.width         = smallest;
+		image.height        = smallest;
+	}
+	auto values = image.expand();
+	for (auto& f : values)
+		f = blt::linear_to_srgb(f);
+	// 8 bit gamma encoded pixels are no longer linear afterwards, they are stored as plain 8 bit values instead
+	image.format = display_pixel_format(image.format);
+	image.pixels = encode_pixels(image.format, values.data(), values.size() / 4);
+}
+
+static std::vector<blt::color_t> sample_grid(const feature_space_t space, const color_plane_t& plane, const blt::i32 samples)
+{
+	switch (space)
+	{
+		case feature_space_t::OKLAB:
+			return sampler_oklab_op_t{plane, samples}.averages;
+		case feature_space_t::SRGB:
+			return sampler_srgb_op_t{plane, samples}.averages;
+		case feature_space_t::HSV:
+			return sampler_hsv_op_t{plane, samples}.averages;
+		case feature_space_t::LINEAR_RGB:
+		default:
+			return sampler_linear_rgb_op_t{plane, samples}.averages;
+	}
+}
+
+static std::vector<blt::color_t> sample_kernel(const feature_space_t space, const color_plane_t& plane, const blt::i32 size)
+{
+	switch (space)
+	{
+		case feature_space_t::OKLAB:
+			return sampler_kernel_filter_oklab_t{plane, size}.kernel_averages;
+		case feature_space_t::SRGB:
+			return sampler_kernel_filter_srgb_t{plane, size}.kernel_averages;
+		case feature_space_t::HSV:
+			return sampler_kernel_filter_hsv_t{plane, size}.kernel_averages;
+		case feature_space_t::LINEAR_RGB:
+		default:
+			return sampler_kernel_filter_rgb_t{plane, size}.kernel_averages;
+	}
+}
+
+// every texture writes to its own slice of the planes so they can be processed independently
+static void parallel_for(const size_t count, const std::function<void(size_t)>& func)
+{
+#ifdef __EMSCRIPTEN__
+	for (size_t i = 0; i < count; i++)
+		func(i);
+#else
+	const size_t             thread_count = std::max(1u, std::thread::hardware_concurrency());
+	std::atomic_size_t       next         = 0;
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < thread_count; t++)
+	{
+		threads.emplace_back([&]() {
+			for (size_t i = next++; i < count; i = next++)
+				func(i);
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+#endif
+}
+
+feature_plane_t::feature_plane_t(const size_t texture_count, const blt::i32 values_per_texture): textures{texture_count},
+	per_texture{values_per_texture}
+{
+	for (auto& channel : channels)
+		channel.resize(texture_count * values_per_texture);
+}
+
+void feature_plane_t::set(const size_t texture, const std::vector<blt::color_t>& values)
+{
+	BLT_ASSERT(values.size() == static_cast<size_t>(per_texture) && "Feature has the wrong number of values for this plane!");
+	for (const auto& [i, value] : blt::enumerate(values))
+	{
+		const auto vec = value.to_vec3();
+		for (size_t c = 0; c < channels.size(); c++)
+			channels[c][texture * per_texture + i] = vec[c];
+	}
+}
+
+void feature_plane_t::set(const size_t texture, const std::vector<blt::vec3>& values)
+{
+	BLT_ASSERT(values.size() == static_cast<size_t>(per_texture) && "Feature has the wrong number of values for this plane!");
+	for (const auto& [i, value] : blt::enumerate(values))
+	{
+		for (size_t c = 0; c < channels.size(); c++)
+			channels[c][texture * per_texture + i] = value[c];
+	}
+}
+
+void feature_plane_t::set(const size_t texture, const float* values)
+{
+	for (blt::i32 i = 0; i < per_texture; i++)
+	{
+		for (size_t c = 0; c < channels.size(); c++)
+			channels[c][texture * per_texture + i] = values[i * 3 + c];
+	}
+}
+
+sampler_feature_t::sampler_feature_t(const feature_plane_t& plane, const size_t texture, const feature_space_t space): plane{&plane},
+	space{space}
+{
+	values.reserve(plane.values_per_texture());
+	if (texture < plane.texture_count())
+		set_texture(texture);
+}
+
+void sampler_feature_t::set_texture(const size_t texture)
+{
+	// vp tree builds compare one vantage point against many textures in a row
+	if (texture == this->texture && !values.empty())
+		return;
+	this->texture = texture;
+	values.clear();
+	for (blt::i32 i = 0; i < plane->values_per_texture(); i++)
+		values.push_back(make_feature_color(space, plane->get(texture, i)));
+}
+
+std::vector<float> texture_feature_store_t::compute(const image_t& image)
+{
+	std::vector<float> values;
+	values.reserve(values_per_texture());
+	const auto append = [&values](const blt::vec3& value) {
+		values.insert(values.end(), {value[0], value[1], value[2]});
+	};
+	for (size_t s = 0; s < feature_space_count; s++)
+	{
+		const auto            space = static_cast<feature_space_t>(s);
+		const fused_sampler_t fused{convert_image(image, space), space, precomputed_samples};
+		append(fused.difference);
+		append(fused.kernel);
+		for (const auto& grid : fused.grids)
+		{
+			for (const auto& value : grid)
+				append(value);
+		}
+	}
+	return values;
+}
+
+void texture_feature_store_t::unpack(const size_t texture, const float* values)
+{
+	for (auto& data : spaces)
+	{
+		data.difference.set(texture, values);
+		values += data.difference.values_per_texture() * 3;
+		data.kernels[0].set(texture, values);
+		values += data.kernels[0].values_per_texture() * 3;
+		for (blt::i32 samples = 1; samples <= precomputed_samples; samples++)
+		{
+			auto& plane = data.grids[samples - 1];
+			plane.set(texture, values);
+			values += plane.values_per_texture() * 3;
+		}
+	}
+}
+
+void texture_feature_store_t::build(std::vector<const image_t*> textures)
+{
+	images = std::move(textures);
+	for (auto& data : spaces)
+	{
+		data            = {};
+		data.difference = feature_plane_t{images.size(), 1};
+		data.kernels[0] = feature_plane_t{images.size(), 1};
+		for (blt::i32 samples = 1; samples <= precomputed_samples; samples++)
+			data.grids[samples - 1] = feature_plane_t{images.size(), samples * samples};
+	}
+
+	std::atomic_size_t computed = 0;
+	parallel_for(images.size(), [&](const size_t id) {
+		const auto& image = *images[id];
+		if (image.features.size() == values_per_texture())
+		{
+			unpack(id, image.features.data());
+			return;
+		}
+		const auto values = compute(image);
+		unpack(id, values.data());
+		++computed;
+	});
+	if (computed > 0)
+		BLT_INFO("Computed features for {} of {} textures", computed.load(), images.size());
+	else
+		BLT_INFO("Loaded stored features for {} textures", images.size());
+}
+
+void texture_feature_store_t::update(const size_t texture)
+{
+	std::scoped_lock lock{*lazy_mutex};
+	const auto&      image = *images[texture];
+	for (size_t s = 0; s < feature_space_count; s++)
+	{
+		const auto            space = static_cast<feature_space_t>(s);
+		const auto            plane = convert_image(image, space);
+		const fused_sampler_t fused{plane, space, max_samples};
+		auto&                 data = spaces[s];
+		data.difference.set(texture, std::vector{fused.difference});
+		data.kernels[0].set(texture, std::vector{fused.kernel});
+		for (blt::i32 samples = 1; samples <= max_samples; samples++)
+		{
+			if (!data.grids[samples - 1].empty())
+				data.grids[samples - 1].set(texture, fused.grids[samples - 1]);
+		}
+		for (blt::i32 size = 2; size <= max_kernel_size; size++)
+		{
+			if (!data.kernels[size - 1].empty())
+				data.kernels[size - 1].set(texture, sample_kernel(space, plane, size));
+		}
+		data.difference.clear_terms();
+		for (const auto& grid : data.grids)
+			grid.clear_terms();
+		for (const auto& kernel : data.kernels)
+			kernel.clear_terms();
+	}
+}
+
+const feature_plane_t& texture_feature_store_t::grid(const feature_space_t space, blt::i32 samples) const
+{
+	samples = std::clamp(samples, 1, max_samples);
+	auto& plane = spaces[static_cast<size_t>(space)].grids[samples - 1];
+	std::scoped_lock lock{*lazy_mutex};
+	if (plane.empty() && !images.empty())
+		build_grid(space, samples);
+	return plane;
+}
+
+void texture_feature_store_t::build_grid(const feature_space_t space, const blt::i32 samples) const
+{
+	auto& plane = spaces[static_cast<size_t>(space)].grids[samples - 1];
+	plane       = feature_plane_t{images.size(), samples * samples};
+	parallel_for(images.size(), [&](const size_t id) {
+		plane.set(id, sample_grid(space, convert_image(*images[id], space), samples));
+	});
+	BLT_DEBUG("Computed {}x{} sample grid for {} textures", samples, samples, images.size());
+}
+
+const feature_plane_t& texture_feature_store_t::kernel(const feature_space_t space, blt::i32 size) const
+{
+	size = std::clamp(size, 1, max_kernel_size);
+	auto& plane = spaces[static_cast<size_t>(space)].kernels[size - 1];
+	std::scoped_lock lock{*lazy_mutex};
+	if (plane.empty() && !images.empty())
+		build_kernel(space, size);
+	return plane;
+}
+
+void texture_feature_store_t::build_kernel(const feature_space_t space, const blt::i32 size) const
+{
+	auto& plane = spaces[static_cast<size_t>(space)].kernels[size - 1];
+	plane       = feature_plane_t{images.size(), 1};
+	parallel_for(images.size(), [&](const size_t id) {
+		plane.set(id, sample_kernel(space, convert_image(*images[id], space), size));
+	});
+	BLT_DEBUG("Computed kernel metric of size {} for {} textures", size, images.size());
+}
@@ -0,0 +1,158 @@
+/*
+ *  <Short Description>
+ *  Copyright (C) 2025  Brett Terpstra
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <texture_index.h>
+#include <algorithm>
+#include <queue>
+#include <blt/logging/logging.h>
+
+vp_tree_t::vp_tree_t(const size_t count, const distance_func_t& distance)
+{
+	std::vector<std::pair<size_t, float>> items;
+	items.reserve(count);
+	for (size_t i = 0; i < count; i++)
+		items.emplace_back(i, 0.0f);
+	nodes.reserve(count);
+	root = build(items, 0, items.size(), distance);
+}
+
+blt::i32 vp_tree_t::build(std::vector<std::pair<size_t, float>>& items, const size_t begin, const size_t end, const distance_func_t& distance)
+{
+	if (begin >= end)
+		return no_child;
+
+	// ids come out of hashmaps so their order is already well mixed, the middle is as good a vantage point as any
+	std::swap(items[begin], items[begin + (end - begin) / 2]);
+	const auto index   = static_cast<blt::i32>(nodes.size());
+	const auto vantage = items[begin].first;
+	nodes.push_back(node_t{vantage});
+
+	if (end - begin == 1)
+		return index;
+
+	for (size_t i = begin + 1; i < end; i++)
+		items[i].second = distance(vantage, items[i].first);
+
+	const auto median = begin + 1 + (end - begin - 1) / 2;
+	std::nth_element(items.begin() + static_cast<blt::ptrdiff_t>(begin + 1),
+					 items.begin() + static_cast<blt::ptrdiff_t>(median),
+					 items.begin() + static_cast<blt::ptrdiff_t>(end),
+					 [](const auto& a, const auto& b) {
+						 return a.second < b.second;
+					 });
+	const auto radius = items[median].second;
+
+	// children are built after the parent so the parent's index never moves, only re-fetch it after recursing
+	const auto inside  = build(items, begin + 1, median, distance);
+	const auto outside = build(items, median, end, distance);
+	nodes[index].radius  = radius;
+	nodes[index].inside  = inside;
+	nodes[index].outside = outside;
+	return index;
+}
+
+std::vector<vp_tree_t::neighbour_t> vp_tree_t::nearest(const size_t             k,
+													   const query_func_t&      distance,
+													   const filter_func_t&     accept,
+													   const std::atomic_bool&  cancelled) const
+{
+	if (k == 0 || root == no_child)
+		return {};
+
+	// max heap on (distance, id), equal distances keep the lower id to match a stable sort over the full scan
+	std::priority_queue<std::pair<float, size_t>> best;
+	const auto tau = [&]() {
+		return best.size() < k ? std::numeric_limits<float>::infinity() : best.top().first;
+	};
+
+	const std::function<void(blt::i32)> search = [&](const blt::i32 n) {
+		if (n == no_child || cancelled)
+			return;
+		const auto& node = nodes[n];
+		const auto  d    = distance(node.id);
+		if (accept(node.id) && (best.size() < k || std::pair{d, node.id} < best.top()))
+		{
+			best.emplace(d, node.id);
+			if (best.size() > k)
+				best.pop();
+		}
+		if (d < node.radius)
+		{
+			if (d - tau() <= node.radius)
+				search(node.inside);
+			if (d + tau() >= node.radius)
+				search(node.outside);
+		} else
+		{
+			if (d + tau() >= node.radius)
+				search(node.outside);
+			if (d - tau() <= node.radius)
+				search(node.inside);
+		}
+	};
+	search(root);
+
+	if (cancelled)
+		return {};
+
+	std::vector<neighbour_t> results;
+	results.reserve(best.size());
+	while (!best.empty())
+	{
+		results.push_back(neighbour_t{best.top().second, best.top().first});
+		best.pop();
+	}
+	std::reverse(results.begin(), results.end());
+	return results;
+}
+
+std::shared_ptr<const vp_tree_t> texture_index_cache_t::get(const texture_index_key_t&                              key,
+															const std::function<std::shared_ptr<const vp_tree_t>()>& build)
+{
+	std::scoped_lock lock{*mutex};
+	for (const auto& [entry_key, tree] : entries)
+	{
+		if (entry_key == key)
+			return tree;
+	}
+	auto tree = build();
+	BLT_DEBUG("Built texture index over {} textures", tree->size());
+	if (entries.size() >= capacity)
+		entries.erase(entries.begin());
+	entries.emplace_back(key, tree);
+	return tree;
+}
+
+std::shared_ptr<const vp_tree_t> texture_index_cache_t::get(const texture_index_key_t& key, const feature_plane_t& grid,
+															comparator_interface_t&    comparator)
+{
+	return get(key, [&]() {
+		sampler_feature_t sampler_a{grid, 0, key.space};
+		sampler_feature_t sampler_b{grid, 0, key.space};
+		return std::make_shared<const vp_tree_t>(grid.texture_count(), [&](const size_t a, const size_t b) {
+			sampler_a.set_texture(a);
+			sampler_b.set_texture(b);
+			return comparator.compare(sampler_a, sampler_b);
+		});
+	});
+}
+
+void texture_index_cache_t::clear()
+{
+	std::scoped_lock lock{*mutex};
+	entries.clear();
+}